@@ -4,10 +4,11 @@
 
 #include "ParserInterfaceSynchronizer.h"
 
-ParserInterfaceSynchronizer::ParserInterfaceSynchronizer(const std::string& out, ParserInterface &target, ResultQueue &sharedQueue)
+ParserInterfaceSynchronizer::ParserInterfaceSynchronizer(const std::string& out, ParserInterface &target, ResultQueue &sharedQueue, EventTape &tape, const FileBufferHandle& file)
 	: ParserInterface()
 	, m_parserInterface(target)
-	, m_queue()
+	, m_tape(tape)
+	, m_file(file)
 	, m_resultQueue(sharedQueue)
 	, m_outputFile(out)
 	, m_unique(0)
@@ -22,292 +23,237 @@ void ParserInterfaceSynchronizer::destroy()
 
 void ParserInterfaceSynchronizer::begin(const std::string_view& source)
 {
-	m_queue = OperationQueue();
+	m_tape.Clear();
+	if (m_file) {
+		m_tape.SetSource(m_file->Data());
+	}
 	m_inputFile = source;
-	auto &pi = m_parserInterface;
-	auto src = std::string(source);
-	enqueue([=, &pi]() {
-		pi.begin(src);
-	});
+	record(Event::kBegin);
+	m_tape.WriteString(source);
 }
 
 void ParserInterfaceSynchronizer::end(const std::string_view& source, const std::string_view &error)
 {
 	assert(m_inputFile == source);
-	auto& pi = m_parserInterface;
-	auto src = std::string(source);
-	auto err = std::string(error);
-	enqueue([=, &pi]() {
-		pi.end(src, err);
-	});
+	record(Event::kEnd);
+	m_tape.WriteString(source);
+	m_tape.WriteString(error);
 	m_resultQueue.push(Result{
-		std::move(m_queue)
+		m_parserInterface,
+		m_tape,
+		m_file
 	});
+	m_tape.Clear();
 }
 
 void ParserInterfaceSynchronizer::include(const std::string_view& filename)
 {
-	auto& pi = m_parserInterface;
-	auto fn = std::string(filename);
-	enqueue([=, &pi]() {
-		pi.include(fn);
-	});
+	record(Event::kInclude);
+	m_tape.WriteString(filename);
 }
 
 void ParserInterfaceSynchronizer::comment(const std::string_view& comment)
 {
-	auto& pi = m_parserInterface;
-	auto com = std::string(comment);
-	enqueue([=, &pi]() {
-		pi.include(com);
-	});
+	record(Event::kComment);
+	m_tape.WriteString(comment);
+}
+
+bool ParserInterfaceSynchronizer::needsComments() const
+{
+	return m_parserInterface.needsComments();
 }
 
 void ParserInterfaceSynchronizer::access(AccessControlType act)
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.access(act);
-	});
+	record(Event::kAccess);
+	m_tape.WriteByte(uint8_t(act));
 }
 
 void ParserInterfaceSynchronizer::using_(bool hasAssigment)
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.using_(hasAssigment);
-	});
+	record(Event::kUsing);
+	m_tape.WriteByte(hasAssigment);
 }
 
 void ParserInterfaceSynchronizer::friend_()
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.friend_();
-	});
+	record(Event::kFriend);
 }
 
 void ParserInterfaceSynchronizer::beginEnum(int startLine, const std::string_view& name, const std::string_view& base, bool isEnumClass)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	auto bas = std::string(base);
-	enqueue([=, &pi]() {
-		pi.beginEnum(startLine, nam, bas, isEnumClass);
-	});
+	record(Event::kBeginEnum);
+	m_tape.WriteVarint(uint32_t(startLine));
+	m_tape.WriteString(name);
+	m_tape.WriteString(base);
+	m_tape.WriteByte(isEnumClass);
 }
 
 void ParserInterfaceSynchronizer::enumValue(const std::string_view& key, const std::string_view& value)
 {
-	auto& pi = m_parserInterface;
-	auto k = std::string(key);
-	auto v = std::string(value);
-	enqueue([=, &pi]() {
-		pi.enumValue(k, v);
-	});
+	record(Event::kEnumValue);
+	m_tape.WriteString(key);
+	m_tape.WriteString(value);
 }
 
 void ParserInterfaceSynchronizer::endEnum(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endEnum(nam);
-	});
+	record(Event::kEndEnum);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::beginClass(int startLine, const std::string_view& name, ScopeType type)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginClass(startLine, nam, type);
-	});
+	record(Event::kBeginClass);
+	m_tape.WriteVarint(uint32_t(startLine));
+	m_tape.WriteString(name);
+	m_tape.WriteByte(uint8_t(type));
 }
 
 void ParserInterfaceSynchronizer::baseType()
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.baseType();
-	});
+	record(Event::kBaseType);
 }
 
 void ParserInterfaceSynchronizer::endClass(const std::string_view& name, bool forwardDecl)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endClass(nam, forwardDecl);
-	});
+	record(Event::kEndClass);
+	m_tape.WriteString(name);
+	m_tape.WriteByte(forwardDecl);
 }
 
 void ParserInterfaceSynchronizer::beginNamespace(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginNamespace(nam);
-	});
+	record(Event::kBeginNamespace);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::endNamespace(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endNamespace(nam);
-	});
+	record(Event::kEndNamespace);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::beginTemplate()
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.beginTemplate();
-	});
+	record(Event::kBeginTemplate);
 }
 
 void ParserInterfaceSynchronizer::templateArgument(const std::string_view& name, bool hasDefaultType)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.templateArgument(nam, hasDefaultType);
-	});
+	record(Event::kTemplateArgument);
+	m_tape.WriteString(name);
+	m_tape.WriteByte(hasDefaultType);
 }
 
 void ParserInterfaceSynchronizer::endTemplate()
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.endTemplate();
-	});
+	record(Event::kEndTemplate);
 }
 
 void ParserInterfaceSynchronizer::beginType(TypeNode::Type type, Specifiers specifiers)
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.beginType(type, specifiers);
-	});
+	record(Event::kBeginType);
+	m_tape.WriteByte(uint8_t(type));
+	m_tape.WriteRaw(specifiers);
 }
 
 void ParserInterfaceSynchronizer::typeName(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.typeName(nam);
-	});
+	record(Event::kTypeName);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::endType()
 {
-	auto& pi = m_parserInterface;
-	enqueue([=, &pi]() {
-		pi.endType();
-	});
+	record(Event::kEndType);
+}
+
+bool ParserInterfaceSynchronizer::needsTypeNodes() const
+{
+	return m_parserInterface.needsTypeNodes();
+}
+
+void ParserInterfaceSynchronizer::internedType(TypeId id, const std::string_view& spelling)
+{
+	// The spelling is owned by the type table, which outlives the queue
+	record(Event::kInternedType);
+	m_tape.WriteVarint(id);
+	m_tape.WriteRaw(spelling.data());
+	m_tape.WriteVarint(spelling.length());
 }
 
 void ParserInterfaceSynchronizer::beginProperty(int startLine, const std::string_view& name, Specifiers specifiers)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginProperty(startLine, nam, specifiers);
-	});
+	record(Event::kBeginProperty);
+	m_tape.WriteVarint(uint32_t(startLine));
+	m_tape.WriteString(name);
+	m_tape.WriteRaw(specifiers);
 }
 
 void ParserInterfaceSynchronizer::arraySubscript(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.arraySubscript(nam);
-	});
+	record(Event::kArraySubscript);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::endProperty(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endProperty(nam);
-	});
+	record(Event::kEndProperty);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::beginFunction(int startLine, TypeNode::Type type, const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginFunction(startLine, type, nam);
-	});
+	record(Event::kBeginFunction);
+	m_tape.WriteVarint(uint32_t(startLine));
+	m_tape.WriteByte(uint8_t(type));
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::functionArgument(const std::string_view& name, const std::string_view& defaultValue)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	auto def = std::string(defaultValue);
-	enqueue([=, &pi]() {
-		pi.functionArgument(nam, def);
-	});
+	record(Event::kFunctionArgument);
+	m_tape.WriteString(name);
+	m_tape.WriteString(defaultValue);
 }
 
 void ParserInterfaceSynchronizer::endFunction(const std::string_view& name, Specifiers specifiers)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endFunction(nam, specifiers);
-	});
+	record(Event::kEndFunction);
+	m_tape.WriteString(name);
+	m_tape.WriteRaw(specifiers);
 }
 
 void ParserInterfaceSynchronizer::beginTypedef(int startLine, const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginTypedef(startLine, nam);
-	});
+	record(Event::kBeginTypedef);
+	m_tape.WriteVarint(uint32_t(startLine));
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::endTypedef(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endTypedef(nam);
-	});
+	record(Event::kEndTypedef);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::beginMacro(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.beginMacro(nam);
-	});
+	record(Event::kBeginMacro);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::macroArgument(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.macroArgument(nam);
-	});
+	record(Event::kMacroArgument);
+	m_tape.WriteString(name);
 }
 
 void ParserInterfaceSynchronizer::endMacro(const std::string_view& name)
 {
-	auto& pi = m_parserInterface;
-	auto nam = std::string(name);
-	enqueue([=, &pi]() {
-		pi.endMacro(nam);
-	});
+	record(Event::kEndMacro);
+	m_tape.WriteString(name);
 }
 
 std::string ParserInterfaceSynchronizer::UniqueName()
@@ -315,7 +261,169 @@ std::string ParserInterfaceSynchronizer::UniqueName()
 	return std::string("uqn").append(std::to_string(m_unique++));
 }
 
-void ParserInterfaceSynchronizer::enqueue(const OperationFunction& func)
-{
-	m_queue.emplace_back(func);
+void ParserInterfaceSynchronizer::record(Event event)
+{
+	m_tape.WriteByte(uint8_t(event));
+}
+
+void ParserInterfaceSynchronizer::Result::replay()
+{
+	// The arguments are read into locals first, the order in which function arguments are evaluated is unspecified
+	if (m_target) {
+		auto& pi = *m_target;
+		EventTape::Reader reader(m_tape);
+		while (!reader.AtEnd()) {
+			switch (Event(reader.ReadByte())) {
+			case Event::kBegin:
+				pi.begin(reader.ReadString());
+				break;
+			case Event::kEnd: {
+				const auto source = reader.ReadString();
+				const auto error = reader.ReadString();
+				pi.end(source, error);
+				break;
+			}
+			case Event::kInclude:
+				pi.include(reader.ReadString());
+				break;
+			case Event::kComment:
+				pi.comment(reader.ReadString());
+				break;
+			case Event::kAccess:
+				pi.access(AccessControlType(reader.ReadByte()));
+				break;
+			case Event::kUsing:
+				pi.using_(reader.ReadByte() != 0);
+				break;
+			case Event::kFriend:
+				pi.friend_();
+				break;
+			case Event::kBeginEnum: {
+				const auto startLine = int(reader.ReadVarint());
+				const auto name = reader.ReadString();
+				const auto base = reader.ReadString();
+				const auto isEnumClass = reader.ReadByte() != 0;
+				pi.beginEnum(startLine, name, base, isEnumClass);
+				break;
+			}
+			case Event::kEnumValue: {
+				const auto key = reader.ReadString();
+				const auto value = reader.ReadString();
+				pi.enumValue(key, value);
+				break;
+			}
+			case Event::kEndEnum:
+				pi.endEnum(reader.ReadString());
+				break;
+			case Event::kBeginClass: {
+				const auto startLine = int(reader.ReadVarint());
+				const auto name = reader.ReadString();
+				const auto type = ScopeType(reader.ReadByte());
+				pi.beginClass(startLine, name, type);
+				break;
+			}
+			case Event::kBaseType:
+				pi.baseType();
+				break;
+			case Event::kEndClass: {
+				const auto name = reader.ReadString();
+				const auto forwardDecl = reader.ReadByte() != 0;
+				pi.endClass(name, forwardDecl);
+				break;
+			}
+			case Event::kBeginNamespace:
+				pi.beginNamespace(reader.ReadString());
+				break;
+			case Event::kEndNamespace:
+				pi.endNamespace(reader.ReadString());
+				break;
+			case Event::kBeginTemplate:
+				pi.beginTemplate();
+				break;
+			case Event::kTemplateArgument: {
+				const auto name = reader.ReadString();
+				const auto hasDefaultType = reader.ReadByte() != 0;
+				pi.templateArgument(name, hasDefaultType);
+				break;
+			}
+			case Event::kEndTemplate:
+				pi.endTemplate();
+				break;
+			case Event::kBeginType: {
+				const auto type = TypeNode::Type(reader.ReadByte());
+				const auto specifiers = reader.ReadRaw<Specifiers>();
+				pi.beginType(type, specifiers);
+				break;
+			}
+			case Event::kTypeName:
+				pi.typeName(reader.ReadString());
+				break;
+			case Event::kEndType:
+				pi.endType();
+				break;
+			case Event::kInternedType: {
+				const auto id = TypeId(reader.ReadVarint());
+				const auto data = reader.ReadRaw<const char*>();
+				const auto length = std::size_t(reader.ReadVarint());
+				pi.internedType(id, std::string_view(data, length));
+				break;
+			}
+			case Event::kBeginProperty: {
+				const auto startLine = int(reader.ReadVarint());
+				const auto name = reader.ReadString();
+				const auto specifiers = reader.ReadRaw<Specifiers>();
+				pi.beginProperty(startLine, name, specifiers);
+				break;
+			}
+			case Event::kArraySubscript:
+				pi.arraySubscript(reader.ReadString());
+				break;
+			case Event::kEndProperty:
+				pi.endProperty(reader.ReadString());
+				break;
+			case Event::kBeginFunction: {
+				const auto startLine = int(reader.ReadVarint());
+				const auto type = TypeNode::Type(reader.ReadByte());
+				const auto name = reader.ReadString();
+				pi.beginFunction(startLine, type, name);
+				break;
+			}
+			case Event::kFunctionArgument: {
+				const auto name = reader.ReadString();
+				const auto defaultValue = reader.ReadString();
+				pi.functionArgument(name, defaultValue);
+				break;
+			}
+			case Event::kEndFunction: {
+				const auto name = reader.ReadString();
+				const auto specifiers = reader.ReadRaw<Specifiers>();
+				pi.endFunction(name, specifiers);
+				break;
+			}
+			case Event::kBeginTypedef: {
+				const auto startLine = int(reader.ReadVarint());
+				const auto name = reader.ReadString();
+				pi.beginTypedef(startLine, name);
+				break;
+			}
+			case Event::kEndTypedef:
+				pi.endTypedef(reader.ReadString());
+				break;
+			case Event::kBeginMacro:
+				pi.beginMacro(reader.ReadString());
+				break;
+			case Event::kMacroArgument:
+				pi.macroArgument(reader.ReadString());
+				break;
+			case Event::kEndMacro:
+				pi.endMacro(reader.ReadString());
+				break;
+			}
+		}
+	}
+
+	while (!m_queue.empty()) {
+		m_queue.front()();
+		m_queue.pop_front();
+	}
 }
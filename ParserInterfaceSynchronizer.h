@@ -1,47 +1,71 @@
 #include <functional>
 #include <deque>
 
+#include "event_tape.h"
+#include "file_buffer.h"
 #include "parser_interface.h"
 #include "TypeData.h"
 #include "MPMCQueue.h"
 
-class ParserInterfaceSynchronizer
+class ParserInterfaceSynchronizer final
 	: public ParserInterface
 {
 public:
 	typedef std::function<void()> OperationFunction;
 	typedef std::deque<OperationFunction> OperationQueue;
+
+	/// The events of one file for the target, or operations such as log messages that run on the consumer thread
 	struct Result
 	{
 		Result() = default;
 		Result(const OperationQueue& queue)
-			: m_queue(queue)
+			: m_target(nullptr)
+			, m_queue(queue)
 		{
 		}
 
-		Result(const Result&other) noexcept
-			: m_queue(other.m_queue)
+		Result(ParserInterface& target, const EventTape& tape, const FileBufferHandle& file)
+			: m_target(&target)
+			, m_tape(tape)
+			, m_file(file)
 		{
-
 		}
 
 		Result(Result&& other) noexcept
-			: m_queue(std::move(other.m_queue))
+			: m_target(other.m_target)
+			, m_tape(std::move(other.m_tape))
+			, m_file(std::move(other.m_file))
+			, m_queue(std::move(other.m_queue))
 		{
 
 		}
 
 		Result& operator=(Result&& other) noexcept
 		{
+			m_target = other.m_target;
+			m_tape = std::move(other.m_tape);
+			m_file = std::move(other.m_file);
 			m_queue = std::move(other.m_queue);
 			return *this;
 		}
 
+		/// Sends the events on the tape to the target, then runs the queued operations
+		void replay();
+
+		ParserInterface* m_target = nullptr;
+		EventTape m_tape;
+
+		/// The file the strings on the tape point into, it stays mapped until the result is gone
+		FileBufferHandle m_file;
+
 		OperationQueue m_queue;
 	};
 	typedef rigtorp::MPMCQueue<Result> ResultQueue;
 
-	ParserInterfaceSynchronizer(const std::string& out, ParserInterface &target, ResultQueue &sharedQueue);
+	/// The events are recorded on tape, which the worker reuses for every file it parses. The result of a file gets
+	/// a copy of the tape and a handle to file. Strings that are in the file are recorded as their offset into it,
+	/// only the strings the parser put together are copied onto the tape.
+	ParserInterfaceSynchronizer(const std::string& out, ParserInterface &target, ResultQueue &sharedQueue, EventTape &tape, const FileBufferHandle& file = FileBufferHandle());
 
 	void destroy() override;
 	void begin(const std::string_view& source) override;
@@ -49,6 +73,7 @@ public:
 
 	void include(const std::string_view& filename) override;
 	void comment(const std::string_view& comment) override;
+	bool needsComments() const override;
 	void access(AccessControlType act) override;
 	void using_(bool hasAssigment) override;
 	void friend_() override;
@@ -71,6 +96,8 @@ public:
 	void beginType(TypeNode::Type type, Specifiers specifiers) override;
 	void typeName(const std::string_view& name) override;
 	void endType() override;
+	bool needsTypeNodes() const override;
+	void internedType(TypeId id, const std::string_view& spelling) override;
 
 	void beginProperty(int startLine, const std::string_view& name, Specifiers specifiers) override;
 	void arraySubscript(const std::string_view& name) override;
@@ -88,9 +115,48 @@ public:
 	void endMacro(const std::string_view& name) override;
 
 private:
+	/// The opcodes of the events on the tape
+	enum class Event : uint8_t
+	{
+		kBegin,
+		kEnd,
+		kInclude,
+		kComment,
+		kAccess,
+		kUsing,
+		kFriend,
+		kBeginEnum,
+		kEnumValue,
+		kEndEnum,
+		kBeginClass,
+		kBaseType,
+		kEndClass,
+		kBeginNamespace,
+		kEndNamespace,
+		kBeginTemplate,
+		kTemplateArgument,
+		kEndTemplate,
+		kBeginType,
+		kTypeName,
+		kEndType,
+		kInternedType,
+		kBeginProperty,
+		kArraySubscript,
+		kEndProperty,
+		kBeginFunction,
+		kFunctionArgument,
+		kEndFunction,
+		kBeginTypedef,
+		kEndTypedef,
+		kBeginMacro,
+		kMacroArgument,
+		kEndMacro
+	};
+
 	ParserInterface& m_parserInterface;
 
-	OperationQueue m_queue;
+	EventTape& m_tape;
+	FileBufferHandle m_file;
 	ResultQueue &m_resultQueue;
 
 	std::string m_inputFile;
@@ -100,5 +166,5 @@ private:
 
 	std::string UniqueName();
 
-	void enqueue(const OperationFunction& func);
+	void record(Event event);
 };
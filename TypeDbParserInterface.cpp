@@ -85,6 +85,11 @@ void TypeDbParserInterface::comment(const std::string_view& c)
 
 }
 
+bool TypeDbParserInterface::needsComments() const
+{
+	return false;
+}
+
 void TypeDbParserInterface::access(AccessControlType act)
 {
 	m_access = act;
@@ -92,8 +97,8 @@ void TypeDbParserInterface::access(AccessControlType act)
 
 void TypeDbParserInterface::using_(bool hasAssigment)
 {
-	TypeData type1, type2;
-	TypeData *key, *value;
+	std::string type1, type2;
+	std::string *key, *value;
 	assert(takeType(type1) == true);
 	if (hasAssigment) {
 		assert(takeType(type2) == true);
@@ -106,7 +111,7 @@ void TypeDbParserInterface::using_(bool hasAssigment)
 
 void TypeDbParserInterface::friend_()
 {
-	TypeData type;
+	std::string type;
 	assert(takeType(type) == true);
 }
 
@@ -148,11 +153,11 @@ void TypeDbParserInterface::beginClass(int startLine, const std::string_view& na
 
 void TypeDbParserInterface::baseType()
 {
-	TypeData type;
+	std::string type;
 	assert(takeType(type) == true);
 	auto node = nodeTop().append_child("base");
 	node.append_attribute("access").set_value(Access2String(m_access));
-	node.text().set(type.ToString());
+	node.text().set(type);
 }
 
 void TypeDbParserInterface::endClass(const std::string_view& name, bool forwardDecl)
@@ -178,14 +183,14 @@ void TypeDbParserInterface::beginTemplate()
 
 void TypeDbParserInterface::templateArgument(const std::string_view& name, bool hasDefaultType)
 {
-	TypeData defaultTyp;
-	TypeData paramTyp;
+	std::string defaultTyp;
+	std::string paramTyp;
 	if (hasDefaultType) {
 		assert(takeType(defaultTyp) == true);
 	}
 	assert(takeType(paramTyp) == true);
 	m_templateData.emplace_back(TemplateArgument{
-		paramTyp.ToString(), std::string(name), defaultTyp.ToString()
+		paramTyp, std::string(name), defaultTyp
 	});
 }
 
@@ -224,17 +229,27 @@ void TypeDbParserInterface::endType()
 	assert(top != nullptr);
 	m_typeStack.pop_back();
 	if (m_typeStack.empty()) {
-		m_doneTypes.push_back(m_typeData);
+		m_doneTypes.push_back(m_typeData.ToString());
 	}
 }
 
+bool TypeDbParserInterface::needsTypeNodes() const
+{
+	return false;
+}
+
+void TypeDbParserInterface::internedType(TypeId id, const std::string_view& spelling)
+{
+	m_doneTypes.emplace_back(spelling);
+}
+
 void TypeDbParserInterface::beginProperty(int startLine, const std::string_view& name, Specifiers specifiers)
 {
-	TypeData type;
+	std::string type;
 	assert(takeType(type) == true);
 	pushElement("property", name);
 	rewriteAttribute("spec").set_value(specifiers.ToString());
-	rewriteAttribute("type").set_value(type.ToString());
+	rewriteAttribute("type").set_value(type);
 }
 
 void TypeDbParserInterface::arraySubscript(const std::string_view& name)
@@ -249,23 +264,23 @@ void TypeDbParserInterface::endProperty(const std::string_view& name)
 
 void TypeDbParserInterface::beginFunction(int startLine, TypeNode::Type type, const std::string_view& name)
 {
-	TypeData returnType;
+	std::string returnType;
 	assert(takeType(returnType) == true);
 
 	auto node = pushElement("function", name);
 	rewriteAttribute("access").set_value(Access2String(m_access));
-	rewriteAttribute("returns").set_value(returnType.ToString());
+	rewriteAttribute("returns").set_value(returnType);
 
 	processTemplate();
 }
 
 void TypeDbParserInterface::functionArgument(const std::string_view& name, const std::string_view& defaultValue)
 {
-	TypeData type;
+	std::string type;
 	assert(takeType(type) == true);
 	auto node = nodeTop().append_child("argument");
 	node.append_attribute("name").set_value(name);
-	node.append_attribute("type").set_value(type.ToString());
+	node.append_attribute("type").set_value(type);
 }
 
 void TypeDbParserInterface::endFunction(const std::string_view& name, Specifiers specifiers)
@@ -276,10 +291,10 @@ void TypeDbParserInterface::endFunction(const std::string_view& name, Specifiers
 
 void TypeDbParserInterface::beginTypedef(int startLine, const std::string_view& name)
 {
-	TypeData type;
+	std::string type;
 	assert(takeType(type) == true);
 	pushElement("typedef", name);
-	rewriteAttribute("type").set_value(type.ToString());
+	rewriteAttribute("type").set_value(type);
 }
 
 void TypeDbParserInterface::endTypedef(const std::string_view& name)
@@ -343,7 +358,7 @@ TypeData* TypeDbParserInterface::typeTop() const
 	return m_typeStack.empty() ? nullptr : m_typeStack.back();
 }
 
-bool TypeDbParserInterface::takeType(TypeData &out)
+bool TypeDbParserInterface::takeType(std::string &out)
 {
 	if (m_doneTypes.empty()) {
 		return false;
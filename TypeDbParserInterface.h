@@ -19,6 +19,7 @@ public:
 
 	void include(const std::string_view& filename) override;
 	void comment(const std::string_view& c) override;
+	bool needsComments() const override;
 	void access(AccessControlType act) override;
 	void using_(bool hasAssigment) override;
 	void friend_() override;
@@ -41,6 +42,8 @@ public:
 	void beginType(TypeNode::Type type, Specifiers specifiers) override;
 	void typeName(const std::string_view& name) override;
 	void endType() override;
+	bool needsTypeNodes() const override;
+	void internedType(TypeId id, const std::string_view& spelling) override;
 
 	void beginProperty(int startLine, const std::string_view& name, Specifiers specifiers) override;
 	void arraySubscript(const std::string_view& name) override;
@@ -67,7 +70,7 @@ public:
 	*/
 private:
 	TypeData* typeTop() const;
-	bool takeType(TypeData &out);
+	bool takeType(std::string &out);
 	bool takeTemplate(TemplateData& out);
 	bool processTemplate();
 
@@ -87,7 +90,7 @@ private:
 
 	TypeData m_typeData;
 	std::deque<TypeData*> m_typeStack;
-	std::deque<TypeData> m_doneTypes;
+	std::deque<std::string> m_doneTypes;
 
 	TemplateData m_templateData;
 	std::deque<TemplateData> m_doneTemplates;
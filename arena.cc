@@ -0,0 +1,49 @@
+#include "arena.h"
+
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+Arena::Arena(std::size_t blockSize) :
+	block_(0),
+	offset_(0),
+	blockSize_(blockSize)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string_view Arena::Store(const std::string_view& text)
+{
+	if (text.empty())
+		return std::string_view();
+
+	char* data = static_cast<char*>(Allocate(text.length(), 1));
+	std::memcpy(data, text.data(), text.length());
+	return std::string_view(data, text.length());
+}
+
+//--------------------------------------------------------------------------------------------------
+void Arena::Reset()
+{
+	block_ = 0;
+	offset_ = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void* Arena::AllocateSlow(std::size_t size, std::size_t alignment)
+{
+	// Blocks that were used before the last reset are taken in order, blocks that are too small are passed over
+	std::size_t block = blocks_.empty() ? 0 : block_ + 1;
+	while (block < blocks_.size() && blocks_[block].size < size)
+		++block;
+
+	if (block == blocks_.size())
+	{
+		const std::size_t blockSize = size > blockSize_ ? size : blockSize_;
+		blocks_.push_back(Block{ std::unique_ptr<char[]>(new char[blockSize]), blockSize });
+	}
+
+	block_ = block;
+	offset_ = 0;
+	return Allocate(size, alignment);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Bump allocator for objects that are all freed at once.
+/// The blocks are kept when the arena is reset, so an arena that has grown to its working size does not
+/// allocate anymore. Destructors are never called, which is why only trivially destructible objects can be created.
+class Arena
+{
+public:
+	explicit Arena(std::size_t blockSize = 16 * 1024);
+
+	// Do not allow copy
+	Arena(const Arena& other) = delete;
+
+	/// Constructs an object in the arena
+	template<typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Blocks are only aligned for fundamental types");
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	/// Copies the text into the arena
+	std::string_view Store(const std::string_view& text);
+
+	/// Returns uninitialized memory, alignment must be a power of two no larger than alignof(std::max_align_t)
+	void* Allocate(std::size_t size, std::size_t alignment)
+	{
+		const std::size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+		if (block_ < blocks_.size() && offset + size <= blocks_[block_].size)
+		{
+			offset_ = offset + size;
+			return blocks_[block_].data.get() + offset;
+		}
+		return AllocateSlow(size, alignment);
+	}
+
+	/// Frees all objects while keeping the blocks
+	void Reset();
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	/// Moves on to the next block that is large enough, adding one if there is none
+	void* AllocateSlow(std::size_t size, std::size_t alignment);
+
+	std::vector<Block> blocks_;
+
+	/// The block that is allocated from and the first free byte in it
+	std::size_t block_;
+	std::size_t offset_;
+
+	std::size_t blockSize_;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// Events recorded as bytes: an opcode followed by its arguments, integers as varints and strings as their length
+/// followed by their bytes. Strings that lie in the source of the tape are written as their offset into it instead,
+/// the source has to outlive the tape. The storage is kept when the tape is cleared, a tape that is reused for every
+/// file does not allocate anymore once it has grown to the size of the largest one.
+class EventTape
+{
+public:
+	EventTape() = default;
+	EventTape(const EventTape& other) = default;
+	EventTape(EventTape&& other) noexcept = default;
+	EventTape& operator=(EventTape&& other) noexcept = default;
+
+	/// Removes all events and the source while keeping the storage
+	void Clear()
+	{
+		data_.clear();
+		source_ = std::string_view();
+	}
+
+	/// Sets the text strings are referenced in, usually the input the events were parsed from
+	void SetSource(const std::string_view& source) { source_ = source; }
+
+	bool Empty() const { return data_.empty(); }
+	std::size_t Size() const { return data_.size(); }
+
+	void WriteByte(uint8_t value)
+	{
+		data_.push_back(value);
+	}
+
+	/// Writes 7 bits per byte, the high bit is set on all bytes but the last
+	void WriteVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data_.push_back(uint8_t(value) | 0x80);
+			value >>= 7;
+		}
+		data_.push_back(uint8_t(value));
+	}
+
+	/// The lowest bit of the length tells whether an offset into the source or the bytes follow
+	void WriteString(const std::string_view& value)
+	{
+		const uintptr_t offset = uintptr_t(value.data()) - uintptr_t(source_.data());
+		if (!value.empty() && offset < source_.length() && value.length() <= source_.length() - offset)
+		{
+			WriteVarint(uint64_t(value.length()) << 1 | 1);
+			WriteVarint(offset);
+			return;
+		}
+
+		WriteVarint(uint64_t(value.length()) << 1);
+		data_.insert(data_.end(), value.data(), value.data() + value.length());
+	}
+
+	/// Writes the bytes of a trivially copyable value
+	template<typename T>
+	void WriteRaw(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be written as bytes");
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		data_.insert(data_.end(), bytes, bytes + sizeof(T));
+	}
+
+	/// Reads the events of a tape in the order they were written. Strings point into the tape or its source.
+	class Reader
+	{
+	public:
+		explicit Reader(const EventTape& tape) :
+			pos_(tape.data_.data()),
+			end_(tape.data_.data() + tape.data_.size()),
+			source_(tape.source_)
+		{
+		}
+
+		bool AtEnd() const { return pos_ == end_; }
+
+		uint8_t ReadByte()
+		{
+			return *pos_++;
+		}
+
+		uint64_t ReadVarint()
+		{
+			uint64_t value = 0;
+			for (unsigned shift = 0;; shift += 7)
+			{
+				const uint8_t byte = *pos_++;
+				value |= uint64_t(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0)
+					return value;
+			}
+		}
+
+		std::string_view ReadString()
+		{
+			const uint64_t header = ReadVarint();
+			const std::size_t length = std::size_t(header >> 1);
+			if (header & 1)
+				return source_.substr(std::size_t(ReadVarint()), length);
+
+			const std::string_view value(reinterpret_cast<const char*>(pos_), length);
+			pos_ += length;
+			return value;
+		}
+
+		template<typename T>
+		T ReadRaw()
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be read as bytes");
+			T value;
+			std::memcpy(&value, pos_, sizeof(T));
+			pos_ += sizeof(T);
+			return value;
+		}
+
+	private:
+		const uint8_t* pos_;
+		const uint8_t* end_;
+		std::string_view source_;
+	};
+
+private:
+	std::vector<uint8_t> data_;
+	std::string_view source_;
+};
@@ -0,0 +1,56 @@
+#include "file_buffer.h"
+
+#include <string>
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+//--------------------------------------------------------------------------------------------------
+FileBuffer::FileBuffer(void* file, void* mapping, const std::string_view& data) :
+	file_(file),
+	mapping_(mapping),
+	data_(data)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+FileBuffer::~FileBuffer()
+{
+	if (mapping_ != NULL)
+	{
+		UnmapViewOfFile(data_.data());
+		CloseHandle(mapping_);
+	}
+	CloseHandle(file_);
+}
+
+//--------------------------------------------------------------------------------------------------
+FileBufferHandle FileBuffer::Open(const std::string_view& fileName)
+{
+	HANDLE hFile = CreateFileA(std::string(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FileBufferHandle();
+
+	// Empty files can not be mapped
+	const DWORD size = GetFileSize(hFile, NULL);
+	if (size == 0)
+		return FileBufferHandle(new FileBuffer(hFile, NULL, std::string_view()));
+
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping == NULL)
+	{
+		CloseHandle(hFile);
+		return FileBufferHandle();
+	}
+
+	auto dataPtr = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!dataPtr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return FileBufferHandle();
+	}
+
+	return FileBufferHandle(new FileBuffer(hFile, hMapping, std::string_view(dataPtr, size)));
+}
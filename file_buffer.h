@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+
+class FileBuffer;
+
+/// Shared handle to a mapped file, the mapping is released when the last handle is gone
+typedef std::shared_ptr<const FileBuffer> FileBufferHandle;
+
+/// A file mapped into memory for reading. The result of a file holds a handle to it, so the events can point into
+/// the mapping until the consumer has replayed them.
+class FileBuffer
+{
+public:
+	~FileBuffer();
+
+	// Do not allow copy
+	FileBuffer(const FileBuffer& other) = delete;
+	FileBuffer& operator=(const FileBuffer& other) = delete;
+
+	/// Maps the file, returns an empty handle if it can not be opened
+	static FileBufferHandle Open(const std::string_view& fileName);
+
+	std::string_view Data() const { return data_; }
+
+private:
+	FileBuffer(void* file, void* mapping, const std::string_view& data);
+
+	/// The handles of the file and its mapping, the mapping is null for empty files
+	void* file_;
+	void* mapping_;
+
+	std::string_view data_;
+};
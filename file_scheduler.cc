@@ -0,0 +1,131 @@
+#include "file_scheduler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+	/// Files below this size are taken several at a time, until the batch has kSmallBatchBytes or kSmallBatchFiles
+	const uint64_t kSmallFileSize = 16 * 1024;
+	const uint64_t kSmallBatchBytes = 64 * 1024;
+	const std::size_t kSmallBatchFiles = 32;
+}
+
+//--------------------------------------------------------------------------------------------------
+FileScheduler::FileScheduler(const std::vector<std::string_view>& files, std::size_t workerCount)
+{
+	std::vector<Entry> entries;
+	entries.reserve(files.size());
+	for (const auto& file : files)
+	{
+		// Files that can not be read count as empty, loading them fails later on
+		std::error_code error;
+		const auto size = std::filesystem::file_size(std::filesystem::path(file), error);
+		entries.push_back(Entry{ file, error ? 0 : uint64_t(size) });
+	}
+
+	// Largest first, every file goes to the worker with the fewest bytes so far
+	std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.size > b.size; });
+
+	workers_.reserve(workerCount);
+	for (std::size_t i = 0; i < workerCount; ++i)
+		workers_.push_back(std::make_unique<Worker>());
+
+	std::vector<uint64_t> assigned(workerCount, 0);
+	for (const auto& entry : entries)
+	{
+		const std::size_t worker = std::min_element(assigned.begin(), assigned.end()) - assigned.begin();
+		assigned[worker] += entry.size;
+		workers_[worker]->files.push_back(entry);
+	}
+
+	for (std::size_t i = 0; i < workerCount; ++i)
+		workers_[i]->remaining = assigned[i];
+}
+
+//--------------------------------------------------------------------------------------------------
+bool FileScheduler::Next(std::size_t worker, std::string_view& file)
+{
+	Worker& self = *workers_[worker];
+	if (self.batchPos == self.batch.size())
+	{
+		self.batch.clear();
+		self.batchPos = 0;
+		if (!Take(self, self, false) && !Steal(self))
+			return false;
+	}
+
+	file = self.batch[self.batchPos++].file;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool FileScheduler::Take(Worker& victim, Worker& worker, bool steal)
+{
+	std::lock_guard<std::mutex> lock(victim.mutex);
+
+	uint64_t bytes = 0;
+	std::size_t count = 0;
+	while (!victim.files.empty())
+	{
+		const Entry entry = steal ? victim.files.back() : victim.files.front();
+
+		// A big file is taken alone, small files are taken together until the batch is full
+		if (count != 0 && (entry.size >= kSmallFileSize || bytes + entry.size > kSmallBatchBytes || count == kSmallBatchFiles))
+			break;
+
+		if (steal)
+			victim.files.pop_back();
+		else
+			victim.files.pop_front();
+
+		worker.batch.push_back(entry);
+		bytes += entry.size;
+		++count;
+
+		if (entry.size >= kSmallFileSize)
+			break;
+	}
+
+	victim.remaining -= bytes;
+	worker.stats.files += count;
+	worker.stats.bytes += bytes;
+	if (steal)
+		worker.stats.stolen += count;
+	return count != 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool FileScheduler::Steal(Worker& worker)
+{
+	// No files are added after the start, once every deque is seen empty there is nothing left to steal
+	for (;;)
+	{
+		Worker* victim = nullptr;
+		uint64_t mostRemaining = 0;
+		bool hasFiles = false;
+		for (const auto& other : workers_)
+		{
+			if (other.get() == &worker)
+				continue;
+
+			std::lock_guard<std::mutex> lock(other->mutex);
+			if (other->files.empty())
+				continue;
+
+			hasFiles = true;
+			if (victim == nullptr || other->remaining > mostRemaining)
+			{
+				victim = other.get();
+				mostRemaining = other->remaining;
+			}
+		}
+
+		if (!hasFiles)
+			return false;
+
+		if (Take(*victim, worker, true))
+			return true;
+	}
+}
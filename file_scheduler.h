@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/// Hands out the files of a run to a fixed number of workers. Every worker has its own deque of files, the files are
+/// dealt out by size with the largest first so all workers get about the same number of bytes. A worker takes files
+/// from the front of its deque, small files several at a time, and steals from the back of the deque with the most
+/// bytes left once its own is empty. Big files are started early and the run ends with small ones on every worker.
+class FileScheduler
+{
+public:
+	/// What a worker was given, for the utilization report
+	struct Stats
+	{
+		std::size_t files;
+		uint64_t bytes;
+
+		/// The files the worker took from the deques of other workers
+		std::size_t stolen;
+	};
+
+	/// Reads the sizes of the files and deals them out to workerCount workers
+	FileScheduler(const std::vector<std::string_view>& files, std::size_t workerCount);
+
+	// Do not allow copy
+	FileScheduler(const FileScheduler& other) = delete;
+
+	/// Returns the next file for the worker, false once there is no file left for any worker.
+	/// Each worker has to call this from one thread only.
+	bool Next(std::size_t worker, std::string_view& file);
+
+	/// Returns what the worker was given so far, only valid on the thread of the worker
+	const Stats& GetStats(std::size_t worker) const { return workers_[worker]->stats; }
+
+private:
+	struct Entry
+	{
+		std::string_view file;
+		uint64_t size;
+	};
+
+	struct Worker
+	{
+		std::mutex mutex;
+
+		/// The files of the worker, largest first
+		std::deque<Entry> files;
+
+		/// The bytes left in files
+		uint64_t remaining = 0;
+
+		/// The files taken by the worker, they can not be stolen anymore
+		std::vector<Entry> batch;
+		std::size_t batchPos = 0;
+
+		Stats stats{};
+	};
+
+	/// Moves the next files from the deque of victim to the batch of worker, from the back when stealing.
+	/// Returns false if the deque is empty.
+	bool Take(Worker& victim, Worker& worker, bool steal);
+
+	/// Takes files from the worker with the most bytes left, returns false if no worker has files left
+	bool Steal(Worker& worker);
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+};
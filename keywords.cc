@@ -0,0 +1,105 @@
+#include "keywords.h"
+
+namespace {
+	struct KeywordEntry
+	{
+		std::string_view name;
+		Keyword keyword;
+	};
+
+	constexpr KeywordEntry g_keywords[] = {
+		{ "bool", Keyword::kBool },
+		{ "char", Keyword::kChar },
+		{ "class", Keyword::kClass },
+		{ "const", Keyword::kConst },
+		{ "constexpr", Keyword::kConstExpr },
+		{ "default", Keyword::kDefault },
+		{ "define", Keyword::kDefine },
+		{ "delete", Keyword::kDelete },
+		{ "double", Keyword::kDouble },
+		{ "enum", Keyword::kEnum },
+		{ "explicit", Keyword::kExplicit },
+		{ "false", Keyword::kFalse },
+		{ "float", Keyword::kFloat },
+		{ "friend", Keyword::kFriend },
+		{ "include", Keyword::kInclude },
+		{ "inline", Keyword::kInline },
+		{ "int", Keyword::kInt },
+		{ "long", Keyword::kLong },
+		{ "mutable", Keyword::kMutable },
+		{ "namespace", Keyword::kNamespace },
+		{ "noexcept", Keyword::kNoExcept },
+		{ "operator", Keyword::kOperator },
+		{ "override", Keyword::kOverride },
+		{ "private", Keyword::kPrivate },
+		{ "protected", Keyword::kProtected },
+		{ "public", Keyword::kPublic },
+		{ "short", Keyword::kShort },
+		{ "signed", Keyword::kSigned },
+		{ "static", Keyword::kStatic },
+		{ "struct", Keyword::kStruct },
+		{ "template", Keyword::kTemplate },
+		{ "true", Keyword::kTrue },
+		{ "typedef", Keyword::kTypedef },
+		{ "typename", Keyword::kTypename },
+		{ "union", Keyword::kUnion },
+		{ "unsigned", Keyword::kUnsigned },
+		{ "using", Keyword::kUsing },
+		{ "virtual", Keyword::kVirtual },
+		{ "void", Keyword::kVoid },
+		{ "volatile", Keyword::kVolatile },
+	};
+
+	constexpr std::size_t kMinLength = 3;
+	constexpr std::size_t kMaxLength = 9;
+	constexpr unsigned kTableBits = 6;
+
+	/// Multiplicative hash of the first, third and last character and the length of the identifier.
+	/// The multiplier was searched for to map every keyword to its own slot.
+	constexpr std::size_t HashKeyword(const std::string_view& identifier)
+	{
+		const uint32_t key =
+			uint32_t(uint8_t(identifier[0])) << 24 |
+			uint32_t(uint8_t(identifier[2])) << 16 |
+			uint32_t(uint8_t(identifier[identifier.length() - 1])) << 8 |
+			uint32_t(identifier.length());
+		return uint32_t(key * 0x553992D9u) >> (32 - kTableBits);
+	}
+
+	struct KeywordTable
+	{
+		KeywordEntry slots[1 << kTableBits];
+		bool perfect;
+	};
+
+	constexpr KeywordTable BuildKeywordTable()
+	{
+		KeywordTable table{};
+		table.perfect = true;
+		for (const auto& entry : g_keywords)
+		{
+			if (entry.name.length() < kMinLength || entry.name.length() > kMaxLength)
+				table.perfect = false;
+
+			auto& slot = table.slots[HashKeyword(entry.name)];
+			if (slot.keyword != Keyword::kNone)
+				table.perfect = false;
+			slot = entry;
+		}
+		return table;
+	}
+
+	constexpr KeywordTable g_keywordTable = BuildKeywordTable();
+	static_assert(g_keywordTable.perfect, "Two keywords share a slot of the keyword table");
+}
+
+//--------------------------------------------------------------------------------------------------
+Keyword LookupKeyword(const std::string_view& identifier)
+{
+	if (identifier.length() < kMinLength || identifier.length() > kMaxLength)
+		return Keyword::kNone;
+
+	// Every keyword has its own slot, one compare tells if the identifier is the keyword
+	const KeywordEntry& slot = g_keywordTable.slots[HashKeyword(identifier)];
+	return slot.name == identifier ? slot.keyword : Keyword::kNone;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/// Identifiers the parser gives a meaning to
+enum class Keyword : uint8_t
+{
+	kNone,
+	kBool,
+	kChar,
+	kClass,
+	kConst,
+	kConstExpr,
+	kDefault,
+	kDefine,
+	kDelete,
+	kDouble,
+	kEnum,
+	kExplicit,
+	kFalse,
+	kFloat,
+	kFriend,
+	kInclude,
+	kInline,
+	kInt,
+	kLong,
+	kMutable,
+	kNamespace,
+	kNoExcept,
+	kOperator,
+	kOverride,
+	kPrivate,
+	kProtected,
+	kPublic,
+	kShort,
+	kSigned,
+	kStatic,
+	kStruct,
+	kTemplate,
+	kTrue,
+	kTypedef,
+	kTypename,
+	kUnion,
+	kUnsigned,
+	kUsing,
+	kVirtual,
+	kVoid,
+	kVolatile,
+};
+
+/// Returns the keyword the identifier spells, or Keyword::kNone
+Keyword LookupKeyword(const std::string_view& identifier);
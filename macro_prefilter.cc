@@ -0,0 +1,130 @@
+#include "macro_prefilter.h"
+
+namespace
+{
+	const uint32_t kNoState = UINT32_MAX;
+
+	bool IsIdentifierChar(char c)
+	{
+		return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9') || c == '_';
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+MacroPrefilter::MacroPrefilter() :
+	classes_(),
+	classCount_(1),
+	transitions_(1, 0),
+	lengths_(1, 0),
+	outputs_(1, 0),
+	patternCount_(0)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+MacroPrefilter::MacroPrefilter(const std::vector<std::string>& names) :
+	classes_(),
+	classCount_(1),
+	patternCount_(0)
+{
+	// Every byte that occurs in a name gets its own class, all other bytes share class 0
+	for (const auto& name : names)
+	{
+		for (char c : name)
+		{
+			if (classes_[uint8_t(c)] == 0)
+				classes_[uint8_t(c)] = uint8_t(classCount_++);
+		}
+	}
+
+	// Build the trie of the names
+	transitions_.assign(classCount_, kNoState);
+	lengths_.assign(1, 0);
+	outputs_.assign(1, 0);
+	for (const auto& name : names)
+	{
+		if (name.empty())
+			continue;
+
+		uint32_t state = 0;
+		for (char c : name)
+		{
+			const std::size_t index = state * classCount_ + classes_[uint8_t(c)];
+			if (transitions_[index] == kNoState)
+			{
+				transitions_[index] = uint32_t(lengths_.size());
+				transitions_.resize(transitions_.size() + classCount_, kNoState);
+				lengths_.push_back(0);
+				outputs_.push_back(0);
+			}
+			state = transitions_[index];
+		}
+
+		if (lengths_[state] == 0)
+			++patternCount_;
+		lengths_[state] = uint32_t(name.length());
+	}
+
+	// Turn the trie into an automaton breadth first, the rows of the failure states are complete by then
+	std::vector<uint32_t> failures(lengths_.size(), 0);
+	std::vector<uint32_t> order(1, 0);
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		const uint32_t state = order[i];
+		for (std::size_t c = 0; c < classCount_; ++c)
+		{
+			uint32_t& next = transitions_[state * classCount_ + c];
+			const uint32_t failure = state == 0 ? 0 : transitions_[failures[state] * classCount_ + c];
+			if (next == kNoState)
+			{
+				next = failure;
+				continue;
+			}
+
+			failures[next] = failure;
+			outputs_[next] = lengths_[failure] != 0 ? failure : outputs_[failure];
+			order.push_back(next);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+bool MacroPrefilter::Matches(const char* input, std::size_t size) const
+{
+	if (patternCount_ == 0)
+		return false;
+
+	uint32_t state = 0;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		// Most bytes occur in no name and lead back to the root without a table lookup
+		const uint8_t c = classes_[uint8_t(input[i])];
+		if (c == 0)
+		{
+			state = 0;
+			continue;
+		}
+
+		state = transitions_[state * classCount_ + c];
+		if ((lengths_[state] != 0 || outputs_[state] != 0) && IsWholeMatch(input, size, i + 1, state))
+			return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool MacroPrefilter::IsWholeMatch(const char* input, std::size_t size, std::size_t end, uint32_t state) const
+{
+	if (end < size && IsIdentifierChar(input[end]))
+		return false;
+
+	// All names ending here are suffixes of each other, check each one for an identifier character before it
+	for (uint32_t match = lengths_[state] != 0 ? state : outputs_[state]; match != 0; match = outputs_[match])
+	{
+		const std::size_t start = end - lengths_[match];
+		if (start == 0 || !IsIdentifierChar(input[start - 1]))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/// Searches a whole input for the names of the known macros in a single pass (an Aho-Corasick automaton).
+/// Files in which no name occurs contain no annotations and do not need to be parsed in annotation-only mode.
+/// The automaton is not modified after it is built and can be shared by any number of threads.
+class MacroPrefilter
+{
+public:
+	MacroPrefilter();
+
+	/// Builds the automaton for the given names, empty names are ignored
+	explicit MacroPrefilter(const std::vector<std::string>& names);
+
+	/// Returns true if one of the names occurs in the input as a whole identifier. Occurrences in comments,
+	/// strings or inactive branches count as well, the parser sorts them out.
+	bool Matches(const char* input, std::size_t size) const;
+
+	bool Empty() const { return patternCount_ == 0; }
+
+private:
+	/// Returns true if one of the names ending in state at offset end is a whole identifier
+	bool IsWholeMatch(const char* input, std::size_t size, std::size_t end, uint32_t state) const;
+
+	/// Maps every byte to its class, bytes that occur in no name are class 0
+	uint8_t classes_[256];
+
+	std::size_t classCount_;
+
+	/// The next state for every state and class, classCount_ entries per state. State 0 is the root.
+	std::vector<uint32_t> transitions_;
+
+	/// The length of the name ending in each state, 0 if no name ends there
+	std::vector<uint32_t> lengths_;
+
+	/// The next state along the failure links in which a name ends, 0 if there is none
+	std::vector<uint32_t> outputs_;
+
+	std::size_t patternCount_;
+};
@@ -0,0 +1,104 @@
+#include "macro_table.h"
+
+//--------------------------------------------------------------------------------------------------
+MacroTable::MacroTable() :
+	count_(0),
+	firstChars_()
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+MacroTable::MacroTable(const std::vector<std::string>& names) :
+	count_(0),
+	firstChars_()
+{
+	for (const auto& name : names)
+		Add(name);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint64_t MacroTable::Hash(const std::string_view& name)
+{
+	// FNV-1a
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (char c : name)
+	{
+		hash ^= uint8_t(c);
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool MacroTable::Add(const std::string_view& name, uint64_t hash)
+{
+	if (Contains(name, hash))
+		return false;
+
+	// Keep at least half of the slots empty so probe sequences stay short
+	if ((count_ + 1) * 2 > slots_.size())
+		Grow();
+
+	const std::size_t mask = slots_.size() - 1;
+	std::size_t index = std::size_t(hash) & mask;
+	while (slots_[index].offset != kEmpty)
+		index = (index + 1) & mask;
+
+	slots_[index].hash = hash;
+	slots_[index].offset = uint32_t(names_.size());
+	slots_[index].length = uint32_t(name.length());
+	names_.append(name.data(), name.length());
+	++count_;
+
+	if (!name.empty())
+		firstChars_[uint8_t(name[0]) / 64] |= uint64_t(1) << (uint8_t(name[0]) % 64);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool MacroTable::Contains(const std::string_view& name, uint64_t hash) const
+{
+	if (count_ == 0)
+		return false;
+
+	const std::size_t mask = slots_.size() - 1;
+	for (std::size_t index = std::size_t(hash) & mask; slots_[index].offset != kEmpty; index = (index + 1) & mask)
+	{
+		const Slot& slot = slots_[index];
+		if (slot.hash == hash && GetName(slot) == name)
+			return true;
+	}
+
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+void MacroTable::Clear()
+{
+	for (auto& slot : slots_)
+		slot.offset = kEmpty;
+	names_.clear();
+	count_ = 0;
+	for (auto& bits : firstChars_)
+		bits = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void MacroTable::Grow()
+{
+	std::vector<Slot> slots(slots_.empty() ? 16 : slots_.size() * 2, Slot{ 0, kEmpty, 0 });
+	slots_.swap(slots);
+
+	const std::size_t mask = slots_.size() - 1;
+	for (const auto& slot : slots)
+	{
+		if (slot.offset == kEmpty)
+			continue;
+
+		std::size_t index = std::size_t(slot.hash) & mask;
+		while (slots_[index].offset != kEmpty)
+			index = (index + 1) & mask;
+		slots_[index] = slot;
+	}
+}
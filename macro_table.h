@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Open addressing hash set of macro names.
+/// The table owns copies of the names and is probed with string views, so neither adding nor looking up a name
+/// depends on the lifetime of the caller's string and lookups never allocate. A table that is no longer modified
+/// can be shared by any number of threads.
+class MacroTable
+{
+public:
+	MacroTable();
+
+	/// Builds a table holding the given names
+	explicit MacroTable(const std::vector<std::string>& names);
+
+	/// Adds a copy of the name, returns false if the table holds the name already
+	bool Add(const std::string_view& name) { return Add(name, Hash(name)); }
+	bool Add(const std::string_view& name, uint64_t hash);
+
+	/// Returns true if the table holds the name, hash must be Hash(name)
+	bool Contains(const std::string_view& name) const { return Contains(name, Hash(name)); }
+	bool Contains(const std::string_view& name, uint64_t hash) const;
+
+	/// Removes all names while keeping the storage
+	void Clear();
+
+	/// Returns false if no name in the table starts with the given character
+	bool MayStartWith(char c) const { return (firstChars_[uint8_t(c) / 64] >> (uint8_t(c) % 64)) & 1; }
+
+	bool Empty() const { return count_ == 0; }
+	std::size_t Size() const { return count_; }
+
+	static uint64_t Hash(const std::string_view& name);
+
+private:
+	struct Slot
+	{
+		uint64_t hash;
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	static const uint32_t kEmpty = UINT32_MAX;
+
+	std::string_view GetName(const Slot& slot) const { return std::string_view(names_.data() + slot.offset, slot.length); }
+
+	/// Doubles the number of slots and inserts all names again
+	void Grow();
+
+	/// Slots, the number of slots is a power of two
+	std::vector<Slot> slots_;
+
+	/// The names stored back to back
+	std::string names_;
+
+	std::size_t count_;
+
+	/// One bit for every character a name starts with
+	uint64_t firstChars_[4];
+};
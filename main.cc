@@ -6,8 +6,15 @@
 #include <thread>
 #include <atomic>
 
+#include "file_buffer.h"
+#include "file_scheduler.h"
 #include "helpers.h"
+#include "macro_prefilter.h"
 #include "parser.h"
+#include "scanner.h"
+#include "token_stream.h"
+#include "type_table.h"
+#include "work_signal.h"
 #include "handler.h"
 #include "ScopeGuard.h"
 
@@ -50,9 +57,40 @@ int main(int argc, char** argv)
 	// macros
 	bool profile = GetArgumentSwitchPtr("profile") != nullptr;
 
+	// scanning kernels
+	std::string simd = GetArgumentSwitch("simd");
+	if (simd == "scalar") {
+		SetScanLevel(ScanLevel::kScalar);
+	} else if (simd == "sse2") {
+		SetScanLevel(ScanLevel::kSSE2);
+	} else if (!simd.empty() && simd != "avx2") {
+		LOG_ERROR("Unknown scanning kernel " << simd.c_str());
+		return -1;
+	}
+
+	// lex whole files up front instead of token by token
+	bool pretokenize = GetArgumentSwitchPtr("pretokenize") != nullptr;
+
+	// only parse declarations annotated with one of the macros
+	bool annotationsOnly = GetArgumentSwitchPtr("annotations-only") != nullptr;
+
 	std::string macros = GetArgumentSwitch("macros");
 	const auto macroList = Explode(macros, ",");
 
+	// the known macros are shared by all parsers, #defines go to the parser that found them
+	const MacroTable macroTable(macroList);
+
+	// in annotation-only mode files in which no macro occurs are not parsed at all
+	const MacroPrefilter macroPrefilter(macroList);
+	const bool prefilter = annotationsOnly;
+
+	// macro values for conditional directives, with --strict-defines every other macro is undefined
+	std::string defines = GetArgumentSwitch("defines");
+	const DefineTable defineTable(Explode(defines, ","), GetArgumentSwitchPtr("strict-defines") != nullptr);
+
+	// types are interned once for all threads
+	TypeTable typeTable;
+
 	std::vector<std::string_view> fileList;
 	auto fileListSwitch = GetArgumentSwitch("list");
 	if (!fileListSwitch.empty()) {
@@ -71,11 +109,6 @@ int main(int argc, char** argv)
 		fileList.push_back(inputFile);
 	}
 
-	rigtorp::MPMCQueue<std::string_view> fileQueue(fileList.size());
-	for (const auto& file : fileList) {
-		fileQueue.emplace(file);
-	}
-
 	// select generator
 	std::string generator = GetArgumentSwitch("generator", "typedb");
 	const auto generatorIt = generators.find(generator);
@@ -90,51 +123,95 @@ int main(int argc, char** argv)
 	}
 
 	double t1 = GetTime();
-	ParserInterfaceSynchronizer::ResultQueue sharedQueue(4096);
+	const ptrdiff_t sharedQueueSize = 4096;
+	ParserInterfaceSynchronizer::ResultQueue sharedQueue(sharedQueueSize);
+
+	// the consumer sleeps while there are no results, workers sleep while the consumer is far behind
+	WorkSignal resultsReady;
+	WorkSignal resultsTaken;
 	size_t threadCount = std::thread::hardware_concurrency() - 1;
 	if (fileList.size() < threadCount) {
 		threadCount = fileList.size();
 	}
 
+	// every thread starts with its share of the files, largest first, and takes from the others once it runs out
+	FileScheduler scheduler(fileList, threadCount);
+
 	std::atomic<size_t> threadCounter = threadCount;
 	std::atomic<size_t> filesParsed = 0;
+	std::atomic<size_t> filesSkipped = 0;
 	std::vector<std::thread> threadList;
 	for (size_t cnt = threadCount; cnt; cnt--) {
-		threadList.emplace_back(std::thread{ [=, &macroList, &threadCounter, &outputFile, &sharedQueue, &fileQueue, &filesParsed]() {
-			double startTime = GetTime();
+		threadList.emplace_back(std::thread{ [=, &macroTable, &macroPrefilter, &defineTable, &typeTable, &threadCounter, &outputFile, &sharedQueue, &scheduler, &filesParsed, &filesSkipped, &resultsReady, &resultsTaken]() {
+			double threadStartTime = GetTime();
+			double idleTime = 0;
 			ScopeGuard guard([&]() {
-				// the thread finished
-				if (--threadCounter == 0) {
-
-				}
+				// the thread finished, the consumer stops once all threads are done
+				--threadCounter;
+				resultsReady.Notify();
 			});
 
-			while (!fileQueue.empty()) {
-				std::string_view file;
-				if (!fileQueue.try_pop(file)) {
-					std::this_thread::yield();
-					continue;
-				}
+			// every file parsed by this thread reuses the storage of the token stream and of the event tape
+			TokenStream tokenStream;
+			EventTape eventTape;
+
+			const size_t worker = cnt - 1;
+			std::string_view file;
+			while (scheduler.Next(worker, file)) {
+				// the results of the file are ready for the consumer once it is done
+				ScopeGuard notify([&]() {
+					resultsReady.Notify();
+				});
+
+				// leave room in the result queue for the results of the other threads
+				double waitTime = GetTime();
+				resultsTaken.Wait([&]() {
+					return sharedQueue.size() < sharedQueueSize / 2;
+				});
 
 				double startTime = GetTime();
+				idleTime += startTime - waitTime;
 
-				// load input
-				std::string_view data;
-				if (!LoadFile(file, data)) {
+				// load input, the mapping is released once the consumer is done with the result
+				FileBufferHandle buffer = FileBuffer::Open(file);
+				if (!buffer) {
 					LOG_ERROR_SYNC(sharedQueue, "Failed to load file '" << file << "'");
 					continue;
 				}
+				std::string_view data = buffer->Data();
 
 				double loadFileTime = GetTime();
 
+				// create the result
+				ParserInterfaceSynchronizer synchronizer(outputFile, *parserInterface, sharedQueue, eventTape, buffer);
+
+				// files without annotations get an empty result
+				bool hasMacros = !prefilter || macroPrefilter.Matches(data.data(), data.size());
+				double prefilterTime = GetTime();
+				if (!hasMacros) {
+					synchronizer.begin(file);
+					synchronizer.end(file, std::string_view());
+					++filesParsed;
+					++filesSkipped;
+
+					if (profile) {
+						LOG_INFO_SYNC(sharedQueue, "'" << file << "': load time " << (loadFileTime - startTime) * 1000 << " ms, prefilter time " << (prefilterTime - loadFileTime) * 1000 << " ms, "
+							<< "no macros found, parse skipped");
+					}
+					continue;
+				}
+
 				// create parser
-				ParserInterfaceSynchronizer synchronizer(outputFile, *parserInterface, sharedQueue);
-				Parser parser(synchronizer);
+				Parser<ParserInterfaceSynchronizer> parser(synchronizer);
+				if (pretokenize) {
+					parser.SetTokenStream(&tokenStream);
+				}
 
 				// add known macros
-				for (auto& macro : macroList) {
-					parser.AddMacro(macro);
-				}
+				parser.SetMacroTable(&macroTable);
+				parser.SetDefineTable(&defineTable);
+				parser.SetTypeTable(&typeTable);
+				parser.SetAnnotationsOnly(annotationsOnly);
 
 				// parse input data
 				if (!parser.Parse(file, data)) {
@@ -145,25 +222,56 @@ int main(int argc, char** argv)
 				}
 
 				double endTime = GetTime();
+
+				// declarations that took too much work were skipped, the rest of the file is complete
+				for (const auto& diagnostic : parser.GetBudgetDiagnostics()) {
+					LOG_INFO_SYNC(sharedQueue, "'" << file << "':" << diagnostic.line << ": parse budget exceeded: reason=" << diagnostic.reason
+						<< " relexed=" << diagnostic.bytesRelexed << " depth=" << diagnostic.typeDepth << " input=" << data.size() << ", declaration skipped");
+				}
+
 				if (profile) {
-					LOG_INFO_SYNC(sharedQueue, "'" << file << "': load time " << (loadFileTime - startTime) * 1000 << " ms, parse time " << (endTime - loadFileTime) * 1000 << " ms");
+					size_t tokensLexed = parser.GetTokensLexed();
+					size_t tokenCacheHits = parser.GetTokenCacheHits();
+					size_t typeMemoHits = parser.GetTypeMemoHits();
+					size_t bytesLexed = parser.GetBytesLexed();
+					size_t bytesRelexed = parser.GetBytesRelexed();
+					LOG_INFO_SYNC(sharedQueue, "'" << file << "': load time " << (loadFileTime - startTime) * 1000 << " ms, prefilter time " << (prefilterTime - loadFileTime) * 1000 << " ms, "
+						<< "parse time " << (endTime - prefilterTime) * 1000 << " ms, " << tokensLexed << " tokens lexed, " << tokenCacheHits << " re-lexes avoided, " << typeMemoHits << " type re-parses avoided, "
+						<< bytesLexed << " bytes lexed for " << data.size() << " input bytes, " << bytesRelexed << " re-lexed");
 				}
 			}
+
+			if (profile) {
+				double threadTime = GetTime() - threadStartTime;
+				const FileScheduler::Stats stats = scheduler.GetStats(worker);
+				LOG_INFO_SYNC(sharedQueue, "Worker " << worker << ": busy " << (threadTime - idleTime) * 1000 << " ms, idle " << idleTime * 1000 << " ms, "
+					<< (threadTime > 0 ? (threadTime - idleTime) / threadTime * 100 : 0) << "% utilization, "
+					<< stats.files << " file(s) with " << stats.bytes << " bytes, " << stats.stolen << " of them stolen");
+			}
 		}});
 	}
 
 	double t2 = GetTime();
 
-	while (threadCounter || !sharedQueue.empty()) {
+	double consumerIdleTime = 0;
+	for (;;) {
 		ParserInterfaceSynchronizer::Result result;
 		if (sharedQueue.try_pop(result)) {
-			while (!result.m_queue.empty()) {
-				result.m_queue.front()();
-				result.m_queue.pop_front();
-			}
-		} else {
-			std::this_thread::yield();
+			resultsTaken.Notify();
+			result.replay();
+			continue;
 		}
+
+		// the threads push their results before they finish, nothing is left once they are all done
+		if (threadCounter == 0 && sharedQueue.empty()) {
+			break;
+		}
+
+		double waitTime = GetTime();
+		resultsReady.Wait([&]() {
+			return !sharedQueue.empty() || threadCounter == 0;
+		});
+		consumerIdleTime += GetTime() - waitTime;
 	}
 
 	for (auto& thread : threadList) {
@@ -174,6 +282,14 @@ int main(int argc, char** argv)
 
 	double t3 = GetTime();
 
+	if (profile) {
+		LOG_INFO("Consumer: busy " << (t3 - t2 - consumerIdleTime) * 1000 << " ms, idle " << consumerIdleTime * 1000 << " ms");
+		LOG_INFO("Scanning kernels: " << ScanLevel2String(GetScanLevel()));
+		LOG_INFO("Type table: " << typeTable.Size() << " distinct type(s)");
+		if (prefilter) {
+			LOG_INFO("Prefilter: " << filesSkipped << " of " << fileList.size() << " file(s) contained no macros and were not parsed");
+		}
+	}
 	LOG_INFO("Starting " << threadCount << " thread(s) took: " << (t2 - t1) * 1000 << "ms");
 	LOG_INFO("Total time: " << (t3 - t1) * 1000 << "ms");
 	LOG_INFO("Total file(s) parsed: " << filesParsed);
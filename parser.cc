@@ -3,20 +3,27 @@
 #include <algorithm>
 #include "parser.h"
 #include "token.h"
+#include "scanner.h"
 #include <cstdarg>
 #include <Windows.h>
-#include <unordered_set>
 
 #include "ScopeGuard.h"
+#include "ParserInterfaceSynchronizer.h"
 
-static const std::unordered_set<std::string> g_baseTypes{
-	"void",
-	"bool",
-	"int",
-	"char",
-	"float",
-	"double"
-};
+static bool IsBaseType(Keyword keyword)
+{
+	switch (keyword) {
+	case Keyword::kVoid:
+	case Keyword::kBool:
+	case Keyword::kInt:
+	case Keyword::kChar:
+	case Keyword::kFloat:
+	case Keyword::kDouble:
+		return true;
+	default:
+		return false;
+	}
+}
 
 static std::string_view Signedness2String(SignednessSpecifier sign)
 {
@@ -56,129 +63,133 @@ static bool CanHaveConstructor(ScopeType scope)
 	}
 }
 
-static ScopeType Token2ScopeType(const std::string_view& token)
+static ScopeType Token2ScopeType(Keyword keyword)
 {
-	if (token == "class") {
+	switch (keyword) {
+	case Keyword::kClass:
 		return ScopeType::kClass;
-	} else if (token == "struct") {
-		return ScopeType::kStructure;
-	} else if (token == "struct") {
+	case Keyword::kStruct:
 		return ScopeType::kStructure;
-	} else if (token == "union") {
+	case Keyword::kUnion:
 		return ScopeType::kUnion;
-	} else {
+	default:
 		return ScopeType::kUnknown;
 	}
 }
 
-static bool isStructure(const std::string_view& token)
+static bool isStructure(Keyword keyword)
 {
-	return
-		   token == "class"
-		|| token == "struct"
-		|| token == "union"
-		|| token == "enum"
-	;
+	switch (keyword) {
+	case Keyword::kClass:
+	case Keyword::kStruct:
+	case Keyword::kUnion:
+	case Keyword::kEnum:
+		return true;
+	default:
+		return false;
+	}
 }
 
-static bool isSpecifier(const std::string_view& token)
+static bool isSpecifier(Keyword keyword)
 {
-	return isStructure(token) || token == "typename";
+	return isStructure(keyword) || keyword == Keyword::kTypename;
 }
 
 //-------------------------------------------------------------------------------------------------
 // Class used to write a typenode structure to json
 //-------------------------------------------------------------------------------------------------
-class TypeNodeWriter : public TypeNodeVisitor
+template<class Sink>
+class TypeNodeWriter
 {
 public:
-	TypeNodeWriter(ParserInterface &writer) :
+	TypeNodeWriter(Sink &writer) :
 		writer_(writer) {}
 
 	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(FunctionNode& node) override
+	// Writes the type starting at root, walking down through the children and back up through the owners
+	void Write(const std::vector<TypeNode>& nodes, uint32_t root)
 	{
-		writer_.typeName(node.name);
-
-		// return type
-		VisitNode(*node.returns);
-
-		for (auto& arg : node.arguments)
+		uint32_t index = root;
+		for (;;)
 		{
-			VisitNode(*arg->type, arg->name);
-		}
-	}
-
-	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(LReferenceNode& node) override
-	{
-		VisitNode(*node.base);
-	}
-
-	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(LiteralNode& node) override
-	{
-		writer_.typeName(node.name);
-	}
-
-	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(PointerNode& node) override
-	{
-		VisitNode(*node.base);
-	}
+			const TypeNode& node = nodes[index];
+			writer_.beginType(node.type, node.specifiers);
+			if (!node.argumentName.empty()) {
+				writer_.typeName(node.argumentName);
+			}
+			if (node.HasName()) {
+				writer_.typeName(node.name);
+			}
 
-	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(ReferenceNode& node) override
-	{
-		VisitNode(*node.base);
-	}
+			if (node.child != TypeNode::kNoNode) {
+				index = node.child;
+				continue;
+			}
 
-	//-------------------------------------------------------------------------------------------------
-	virtual void Visit(TemplateNode& node) override
-	{
-		writer_.typeName(node.name);
-		for (auto& arg : node.arguments)
-			VisitNode(*arg);
-	}
+			// Close the types that are complete until one has a next sibling
+			for (;;)
+			{
+				writer_.endType();
+				if (index == root)
+					return;
 
-	//-------------------------------------------------------------------------------------------------
-	virtual void VisitNode(TypeNode &node, const std::string_view &name = std::string_view()) override
-	{
-		writer_.beginType(node.type, node.specifiers);
-		if (!name.empty()) {
-			writer_.typeName(name);
+				if (nodes[index].next != TypeNode::kNoNode) {
+					index = nodes[index].next;
+					break;
+				}
+				index = nodes[index].owner;
+			}
 		}
-		TypeNodeVisitor::VisitNode(node);
-		writer_.endType();
 	}
 
 private:
-	ParserInterface &writer_;
+	Sink &writer_;
 };
 
 //--------------------------------------------------------------------------------------------------
-Parser::Parser(ParserInterface& writer)
+template<class Sink>
+Parser<Sink>::Parser(Sink& writer)
 	: writer_(writer)
 	, m_unnamedCnt(0)
+	, defines_(nullptr)
+	, annotationsOnly_(false)
+	, inAnnotation_(false)
+	, typeMemoHits_(0)
+	, types_(nullptr)
+	, typeDepth_(0)
+	, relexedAtStatement_(0)
 {
 
 }
 
 //--------------------------------------------------------------------------------------------------
-Parser::~Parser()
+template<class Sink>
+Parser<Sink>::~Parser()
 {
 
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::Parse(const std::string_view &fileName, const std::string_view &input)
+template<class Sink>
+bool Parser<Sink>::Parse(const std::string_view &fileName, const std::string_view &input)
 {
+	// Tokens address the input with 32 bit offsets
+	if (input.length() > UINT32_MAX)
+		return Error("Input is too large");
+
 	// Pass the input to the tokenizer
 	Reset(input.data(), input.length());
 
 	// Start the array
 	writer_.begin(fileName);
 
+	// Reset conditionals
+	conditionals_.clear();
+	unknownMacros_.Clear();
+	budgetDiagnostics_.clear();
+	errorAtBudget_.clear();
+	openEvents_.clear();
+
 	// Reset scope
 	scopes_.clear();
 	scopes_.emplace_back(Scope{
@@ -197,110 +208,190 @@ bool Parser::Parse(const std::string_view &fileName, const std::string_view &inp
 	return !HasError();
 }
 
-bool Parser::ParseBaseType(Token& baseType)
+template<class Sink>
+bool Parser<Sink>::ParseBaseType(Token& baseType)
 {
 	if (!GetIdentifier(baseType)) {
 		return false;
 	}
-	const auto& it = g_baseTypes.find(std::string(baseType.token));
-	bool notFound = it == g_baseTypes.cend();
+	bool notFound = !IsBaseType(baseType.keyword);
 	if (notFound) {
 		UngetToken(baseType);
 	}
 	return !notFound;
 }
 
-SignednessSpecifier Parser::ParseSignednessSpecifier()
+template<class Sink>
+SignednessSpecifier Parser<Sink>::ParseSignednessSpecifier()
 {
 	Token token;
 	if (GetIdentifier(token)) {
-		if (token.token == "signed") {
+		switch (token.keyword) {
+		case Keyword::kSigned:
 			return SignednessSpecifier::kSigned;
-		}
-		else if (token.token == "unsigned") {
+		case Keyword::kUnsigned:
 			return SignednessSpecifier::kUnsigned;
-		}
-		else {
+		default:
 			UngetToken(token);
+			break;
 		}
 	}
 	return SignednessSpecifier::kNone;
 }
 
-SizeSpecifier Parser::ParseSizeSpecifier()
+template<class Sink>
+SizeSpecifier Parser<Sink>::ParseSizeSpecifier()
 {
 	Token token;
 	if (GetIdentifier(token)) {
-		if (token.token == "short") {
+		switch (token.keyword) {
+		case Keyword::kShort:
 			return SizeSpecifier::kShort;
-		}
-		else if (token.token == "long") {
-			Token token2;
-			if (GetIdentifier(token2)) {
-				if (token2.token == "long") {
-					return SizeSpecifier::kLongLong;
-				} else {
-					UngetToken(token2);
-				}
+		case Keyword::kLong:
+			if (MatchKeyword(Keyword::kLong)) {
+				return SizeSpecifier::kLongLong;
 			}
 			return SizeSpecifier::kLong;
-		}
-		else {
+		default:
 			UngetToken(token);
+			break;
 		}
 	}
 	return SizeSpecifier::kNone;
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseStatement()
+template<class Sink>
+bool Parser<Sink>::ParseStatement()
 {
+	// The types of the previous statement are no longer referenced
+	typeNodes_.clear();
+	typeMemos_.clear();
+	typeArena_.Reset();
+
+	const std::size_t diagnosticCount = budgetDiagnostics_.size();
+	const std::size_t openEventCount = openEvents_.size();
+	const std::size_t scopeCount = scopes_.size();
+	const bool hadError = HasError();
+	relexedAtStatement_ = GetBytesRelexed();
+
 	Token token;
 	if(!GetToken(token))
 		return false;
 
+	if (annotationsOnly_ && !inAnnotation_)
+	{
+		// The tokenizer reads the annotation in front of the token
+		if (!FollowsMacro(token))
+		{
+			if (SkipUnannotated(token))
+				return true;
+		}
+		else
+		{
+			inAnnotation_ = true;
+			ScopeGuard guard{ [&]() {
+				inAnnotation_ = false;
+			} };
+			if (!ParseDeclaration(token))
+				return SkipOverBudget(token, diagnosticCount, openEventCount, scopeCount, hadError);
+
+			CloseEvents(openEventCount);
+			return true;
+		}
+	}
+
 	if (!ParseDeclaration(token))
+		return SkipOverBudget(token, diagnosticCount, openEventCount, scopeCount, hadError);
+
+	// A function that failed to parse is skipped in place, the events it began are still open
+	CloseEvents(openEventCount);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::SkipUnannotated(const Token &token)
+{
+	// Namespaces, access specifiers and directives are always parsed
+	switch (token.keyword)
+	{
+	case Keyword::kNamespace:
+	case Keyword::kPublic:
+	case Keyword::kProtected:
+	case Keyword::kPrivate:
+		return false;
+	default:
+		break;
+	}
+
+	if (token.tokenType == TokenType::kSymbol && (GetText(token) == "#" || GetText(token) == ";"))
+		return false;
+
+	const size_t end = FindStatementEnd();
+	const size_t stop = end == std::string_view::npos ? inputLength_ : end;
+
+	// Classes are entered if an annotated declaration is nested in them, anything else is skipped up to the next annotation
+	const bool isScope = token.keyword == Keyword::kClass || token.keyword == Keyword::kStruct ||
+		token.keyword == Keyword::kUnion || token.keyword == Keyword::kTemplate;
+	const size_t annotation = FindMacroUse(token.startPos, stop, isScope);
+	if (annotation == std::string_view::npos)
+	{
+		SkipTo(stop);
+		return true;
+	}
+
+	if (isScope)
 		return false;
 
+	SkipTo(annotation);
 	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseDeclaration(Token &token)
+template<class Sink>
+bool Parser<Sink>::ParseDeclaration(Token &token)
 {
-	std::vector<std::string>::const_iterator customMacroIt;
-	if (token.token == "#")
+	if (GetText(token) == "#")
 		return ParseDirective();
 	else if (token.tokenType == TokenType::kMacro)
 		return ParseMacro(token);
-	else if (token.token == ";")
+	else if (GetText(token) == ";")
 			return true; // Empty statement
-	else if (token.token == "typedef")
-			return ParseProperty(token, true);
-	else if (token.token == "using")
-			return ParseUsing(token);
-	else if (token.token == "friend")
-			return ParseFriend(token);
-	else if (token.token == "namespace")
-			return ParseNamespace();
-	else if (token.token == "template")
-			return ParseTemplate();
-	else if (token.token == "enum")
-			return ParseEnum(token);
-	else if (isStructure(token.token))
-			return ParseClass(token);
-	else if (ParseAccessControl(token, scopes_.back().currentAccessControlType))
+
+	switch (token.keyword)
+	{
+	case Keyword::kTypedef:
+		return ParseProperty(token, true);
+	case Keyword::kUsing:
+		return ParseUsing(token);
+	case Keyword::kFriend:
+		return ParseFriend(token);
+	case Keyword::kNamespace:
+		return ParseNamespace();
+	case Keyword::kTemplate:
+		return ParseTemplate();
+	case Keyword::kEnum:
+		return ParseEnum(token);
+	case Keyword::kClass:
+	case Keyword::kStruct:
+	case Keyword::kUnion:
+		return ParseClass(token);
+	default:
+		break;
+	}
+
+	if (ParseAccessControl(token, scopes_.back().currentAccessControlType))
 		return RequireSymbol(":");
 	else if (ParseFunction(token, &scopes_.back()))
 			return true;
 	else
-		return SkipDeclaration(token);
-
-	return true;
+		return SkipDeclaration();
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseDirective()
+template<class Sink>
+bool Parser<Sink>::ParseDirective()
 {
 	Token token;
 	ScopeGuard guard{ [&]() {
@@ -314,64 +405,229 @@ bool Parser::ParseDirective()
 		return Error("Missing compiler directive after #");
 
 	bool multiLineEnabled = false;
-	if(token.token == "define")
+	if(token.keyword == Keyword::kDefine)
 	{
 		if (!GetIdentifier(token)) {
 			return Error("Missing compiler directive identifier");
 		}
-		AddMacro(std::string(token.token));
+		AddMacro(GetText(token));
+		if (InUnknownBranch())
+			unknownMacros_.Add(GetText(token));
 		multiLineEnabled = true;
 	}
-	else if(token.token == "include")
+	else if(token.keyword == Keyword::kInclude)
 	{
 		Token includeToken;
-		GetToken(includeToken, true);
-		writer_.include(std::string(includeToken.token));
+		GetToken<LexMode::kAngleBracketStrings>(includeToken);
+		writer_.include(std::string(GetText(includeToken)));
 	}
-
-	// Skip past the end of the token
-	char lastChar = '\n';
-	do
+	else if(GetText(token) == "undef")
 	{
-		// Skip to the end of the line
-		char c;
-		while (!this->is_eof() && (c = GetChar()) != '\n') {
-			lastChar = c;
-		}
+		Token undefToken;
+		if (GetIdentifier(undefToken))
+			unknownMacros_.Add(GetText(undefToken));
+	}
+	else
+	{
+		const std::string_view directive = GetText(token);
+		if (directive == "if" || directive == "ifdef" || directive == "ifndef" ||
+			directive == "elif" || directive == "else" || directive == "endif")
+			return ParseConditional(directive);
+	}
 
-	} while(multiLineEnabled && lastChar == '\\');
+	// Skip past the end of the line
+	SkipLine(multiLineEnabled);
 
 	SetMacroParsing(true);
 	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::SkipDeclaration(Token &token)
+template<class Sink>
+bool Parser<Sink>::ParseConditional(const std::string_view& directive)
 {
-	int32_t scopeDepth = 0;
-	while(GetToken(token))
+	// The expression is the rest of the line
+	const size_t start = cursorPos_;
+	SkipLine(true);
+	const std::string_view expression(input_ + start, cursorPos_ - start);
+
+	if (directive == "endif")
 	{
-		if(token.token == ";" && scopeDepth == 0)
-			break;
+		if (!conditionals_.empty())
+			conditionals_.pop_back();
+		return true;
+	}
 
-		if(token.token == "{")
-			scopeDepth++;
+	if (directive == "elif" || directive == "else")
+	{
+		// A branch without an #if is ignored
+		if (conditionals_.empty())
+			return true;
 
-		if(token.token == "}")
+		// Only one branch is active
+		if (conditionals_.back().taken)
 		{
-			--scopeDepth;
-			if(scopeDepth == 0)
-				break;
+			SkipConditionalBranch();
+			return true;
+		}
+
+		if (directive == "else")
+		{
+			conditionals_.back().taken = true;
+			return true;
 		}
 	}
+	else
+	{
+		conditionals_.push_back(Conditional{ false, false });
+	}
+
+	Condition condition;
+	if (directive == "ifdef" || directive == "ifndef")
+	{
+		size_t name = expression.find_first_not_of(" \t");
+		name = name == std::string_view::npos ? expression.length() : name;
+		const size_t length = ScanIdentifier(expression.data() + name, expression.length() - name);
+		condition = length == 0 ? Condition::kUnknown : FindMacro(expression.substr(name, length)).defined;
+		if (directive == "ifndef" && condition != Condition::kUnknown)
+			condition = condition == Condition::kTrue ? Condition::kFalse : Condition::kTrue;
+	}
+	else
+	{
+		condition = EvaluateCondition(expression, [this](const std::string_view& name) { return FindMacro(name); });
+	}
+
+	// Inactive branches are skipped on the byte level, unknown ones are parsed
+	if (condition == Condition::kFalse)
+		SkipConditionalBranch();
+	else if (condition == Condition::kTrue)
+		conditionals_.back().taken = true;
+	else
+		conditionals_.back().unknown = true;
 
 	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseEnum(Token &startToken)
+template<class Sink>
+bool Parser<Sink>::InUnknownBranch() const
+{
+	return std::any_of(conditionals_.cbegin(), conditionals_.cend(), [](const Conditional& conditional) { return conditional.unknown; });
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+MacroValue Parser<Sink>::FindMacro(const std::string_view& name) const
 {
-	auto startLine = (unsigned)startToken.startLine;
+	// An include might define a macro again after it was undefined, and a branch that may be inactive might not define it
+	if (unknownMacros_.Contains(name))
+		return MacroValue{ Condition::kUnknown, false, 0 };
+
+	const bool isStrict = defines_ != nullptr && defines_->IsStrict();
+	if (defines_ != nullptr)
+	{
+		const MacroValue value = defines_->Find(name);
+		if (value.defined == Condition::kTrue)
+			return value;
+	}
+
+	// Macros from --macros and #define are defined, but their value is not known
+	if (IsMacro(name))
+		return MacroValue{ Condition::kTrue, false, 0 };
+
+	return MacroValue{ isStrict ? Condition::kFalse : Condition::kUnknown, false, 0 };
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::SkipDeclaration()
+{
+	// Walk the structural index instead of tokenizing everything up to the end of the declaration
+	return SkipStatement();
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::SkipOverBudget(Token &token, std::size_t diagnosticCount, std::size_t openEventCount, std::size_t scopeCount, bool hadError)
+{
+	if (budgetDiagnostics_.size() == diagnosticCount)
+		return false;
+
+	// The declaration failed because the budget stopped it, the error it reported on the way out does not count.
+	// An error of an earlier declaration is put back, the declaration may have overwritten it.
+	hasError_ = hadError;
+	if (hadError)
+		error_.swap(errorAtBudget_);
+	else
+		error_.clear();
+	errorAtBudget_.clear();
+
+	// Events already written for the declaration stay, the ones it began are ended so the sink sees them balanced
+	CloseEvents(openEventCount);
+	while (scopes_.size() > scopeCount)
+		PopScope();
+
+	UngetToken(token);
+	return SkipDeclaration();
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+void Parser<Sink>::CloseEvents(std::size_t count)
+{
+	while (openEvents_.size() > count)
+	{
+		const OpenEvent& event = openEvents_.back();
+		switch (event.kind)
+		{
+		case EventKind::kEnum:
+			writer_.endEnum(event.name);
+			break;
+		case EventKind::kClass:
+			writer_.endClass(event.name, false);
+			break;
+		case EventKind::kNamespace:
+			writer_.endNamespace(event.name);
+			break;
+		case EventKind::kTemplate:
+			writer_.endTemplate();
+			break;
+		case EventKind::kTypedef:
+			writer_.endTypedef(event.name);
+			break;
+		case EventKind::kProperty:
+			writer_.endProperty(event.name);
+			break;
+		case EventKind::kFunction:
+			writer_.endFunction(event.name, Specifiers{});
+			break;
+		}
+		openEvents_.pop_back();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::CheckBudget()
+{
+	const char* reason = nullptr;
+	if (typeDepth_ > kMaxTypeDepth)
+		reason = "depth";
+	else if (GetBytesRelexed() > kRelexFactor * inputLength_ + kRelexSlack && GetBytesRelexed() > relexedAtStatement_)
+		reason = "re-lex";
+	else
+		return true;
+
+	budgetDiagnostics_.push_back(BudgetDiagnostic{ GetLine(cursorPos_), reason, GetBytesRelexed(), typeDepth_ });
+	errorAtBudget_ = error_;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::ParseEnum(Token &startToken)
+{
+	auto startLine = (unsigned)GetLine(startToken.startPos);
 
 	UngetToken(startToken);
 	WriteCurrentAccessControlType();
@@ -380,7 +636,7 @@ bool Parser::ParseEnum(Token &startToken)
 		return false;
 
 	// C++1x enum class type?
-	bool isEnumClass = MatchIdentifier("class");
+	bool isEnumClass = MatchKeyword(Keyword::kClass);
 
 	std::string_view name;
 	std::string_view base;
@@ -388,7 +644,7 @@ bool Parser::ParseEnum(Token &startToken)
 	Token enumToken;
 	if (GetIdentifier(enumToken)) {
 		// type name is optional
-		name = enumToken.token;
+		name = GetText(enumToken);
 	} else {
 		name = GenerateUnnamedIdentifier("enum");
 	}
@@ -401,20 +657,21 @@ bool Parser::ParseEnum(Token &startToken)
 			return Error("Missing enum type specifier after :");
 
 		// Validate base token
-		base = baseToken.token;
+		base = GetText(baseToken);
 	}
 
 	// Require opening brace
 	RequireSymbol("{");
 
 	writer_.beginEnum(startLine, name, base, isEnumClass);
+	openEvents_.push_back(OpenEvent{ EventKind::kEnum, std::string(name) });
 
 	// Parse all the values
 	Token token;
 	while(GetIdentifier(token))
 	{
 		// Store the identifier
-		std::string_view key = token.token;
+		std::string_view key = GetText(token);
 		std::string_view value;
 
 		// Parse constant
@@ -425,11 +682,11 @@ bool Parser::ParseEnum(Token &startToken)
 			UngetToken(startToken);
 
 			// Just parse the value, not doing anything with it atm
-			while (GetToken(token) && (token.tokenType != TokenType::kSymbol || (token.token != "," && token.token != "}"))) {
+			while (GetToken(token) && (token.tokenType != TokenType::kSymbol || (GetText(token) != "," && GetText(token) != "}"))) {
 
 			}
 
-			value = std::string_view(startToken.token.data(), token.startPos - startToken.startPos);
+			value = std::string_view(GetText(startToken).data(), token.startPos - startToken.startPos);
 			UngetToken(token);
 		}
 
@@ -445,13 +702,15 @@ bool Parser::ParseEnum(Token &startToken)
 
 	MatchSymbol(";");
 
+	openEvents_.pop_back();
 	writer_.endEnum(name);
 
 	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-void Parser::PushScope(const std::string_view &name, ScopeType scopeType, AccessControlType accessControlType)
+template<class Sink>
+void Parser<Sink>::PushScope(const std::string_view &name, ScopeType scopeType, AccessControlType accessControlType)
 {
 	scopes_.emplace_back(Scope{
 		scopeType, name, accessControlType
@@ -459,64 +718,68 @@ void Parser::PushScope(const std::string_view &name, ScopeType scopeType, Access
 }
 
 //--------------------------------------------------------------------------------------------------
-void Parser::PopScope()
+template<class Sink>
+void Parser<Sink>::PopScope()
 {
 	scopes_.pop_back();
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseNamespace()
+template<class Sink>
+bool Parser<Sink>::ParseNamespace()
 {
 	Token token;
 	if (!GetIdentifier(token))
 		return Error("Missing namespace name");
 
-	std::string_view name = token.token;
+	std::string_view name = GetText(token);
 
 	if (!RequireSymbol("{"))
 		return false;
 
 	writer_.beginNamespace(name);
-	PushScope(std::string(token.token), ScopeType::kNamespace, AccessControlType::kPublic);
+	openEvents_.push_back(OpenEvent{ EventKind::kNamespace, std::string(name) });
+	PushScope(std::string(GetText(token)), ScopeType::kNamespace, AccessControlType::kPublic);
 
 	while (!MatchSymbol("}"))
 		if (!ParseStatement())
 			return false;
 
 	PopScope();
+	openEvents_.pop_back();
 	writer_.endNamespace(name);
 	return true;
 }
 
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseAccessControl(const Token &token, AccessControlType& type)
+template<class Sink>
+bool Parser<Sink>::ParseAccessControl(const Token &token, AccessControlType& type)
 {
-	if (token.token == "public")
+	switch (token.keyword)
 	{
+	case Keyword::kPublic:
 		type = AccessControlType::kPublic;
 		return true;
-	}
-	else if (token.token == "protected")
-	{
+	case Keyword::kProtected:
 		type = AccessControlType::kProtected;
 		return true;
-	}
-	else if (token.token == "private")
-	{
+	case Keyword::kPrivate:
 		type = AccessControlType::kPrivate;
 		return true;
+	default:
+		return false;
 	}
-	
-	return false;
 }
 
-AccessControlType Parser::GetCurrentAccessControlType() const
+template<class Sink>
+AccessControlType Parser<Sink>::GetCurrentAccessControlType() const
 {
 	return scopes_.back().currentAccessControlType;
 }
 
 //-------------------------------------------------------------------------------------------------
-void Parser::WriteCurrentAccessControlType()
+template<class Sink>
+void Parser<Sink>::WriteCurrentAccessControlType()
 {
 	// Writing access is not required if the current scope is not owned by a class
 	if (scopes_.back().type != ScopeType::kClass)
@@ -526,22 +789,24 @@ void Parser::WriteCurrentAccessControlType()
 }
 
 //-------------------------------------------------------------------------------------------------
-void Parser::WriteAccessControlType(AccessControlType type)
+template<class Sink>
+void Parser<Sink>::WriteAccessControlType(AccessControlType type)
 {
 	writer_.access(type);
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseClass(Token &token)
+template<class Sink>
+bool Parser<Sink>::ParseClass(Token &token)
 {
-	auto startLine = (unsigned)token.startLine;
+	auto startLine = (unsigned)GetLine(token.startPos);
 
 	WriteCurrentAccessControlType();
 
 	if (!ParseComment())
 		return false;
 
-	ScopeType scopeType = Token2ScopeType(token.token);
+	ScopeType scopeType = Token2ScopeType(token.keyword);
 	if (scopeType == ScopeType::kUnknown)
 		return Error("Missing identifier class/struct/union");
 
@@ -552,12 +817,13 @@ bool Parser::ParseClass(Token &token)
 
 	Token classNameToken;
 	if (GetIdentifier(classNameToken)) {
-		name = classNameToken.token;
+		name = GetText(classNameToken);
 	} else {
-		name = GenerateUnnamedIdentifier(token.token);
+		name = GenerateUnnamedIdentifier(GetText(token));
 	}
 
 	writer_.beginClass(startLine, name, scopeType);
+	openEvents_.push_back(OpenEvent{ EventKind::kClass, name });
 
 	// Match base types
 	if(MatchSymbol(":"))
@@ -586,9 +852,10 @@ bool Parser::ParseClass(Token &token)
 
 	if (MatchSymbol(";")) {
 		// forward declaration
+		openEvents_.pop_back();
 		writer_.endClass(name, true);
 		UngetToken(token);
-		return SkipDeclaration(token);
+		return SkipDeclaration();
 	}
 	if (!RequireSymbol("{"))
 		return false;
@@ -601,13 +868,12 @@ bool Parser::ParseClass(Token &token)
 
 	PopScope();
 
+	openEvents_.pop_back();
 	writer_.endClass(name, false);
 
 	Token typedProperty;
 	if (GetIdentifier(typedProperty)) {
-		writer_.beginType(TypeNode::Type::kLiteral, Specifiers{});
-		writer_.typeName(name);
-		writer_.endType();
+		WriteType(NewTypeNode(TypeNode::Type::kLiteral, name));
 		UngetToken(typedProperty);
 		if (!ParseProperty(token, false, true)) {
 			return false;
@@ -621,9 +887,10 @@ bool Parser::ParseClass(Token &token)
 }
 
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
+template<class Sink>
+bool Parser<Sink>::ParseProperty(Token &token, bool isTypedef, bool skipType)
 {
-	auto startLine = (unsigned)token.startLine;
+	auto startLine = (unsigned)GetLine(token.startPos);
 
 	WriteCurrentAccessControlType();
 
@@ -635,8 +902,8 @@ bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
 	bool isMutable = false, isStatic = false;
 	for (bool matched = true; matched;)
 	{
-		matched = (!isMutable && (isMutable = MatchIdentifier("mutable"))) ||
-			(!isStatic && (isStatic = MatchIdentifier("static")));
+		matched = (!isMutable && (isMutable = MatchKeyword(Keyword::kMutable))) ||
+			(!isStatic && (isStatic = MatchKeyword(Keyword::kStatic)));
 	}
 
 	Specifiers specifiers = { 0 };
@@ -655,7 +922,7 @@ bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
 		Token nameToken;
 		if (!GetIdentifier(nameToken))
 			return false;
-		name = nameToken.token;
+		name = GetText(nameToken);
 	}
 
 	if (isTypedef) {
@@ -663,6 +930,7 @@ bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
 	} else {
 		writer_.beginProperty(startLine, name, specifiers);
 	}
+	openEvents_.push_back(OpenEvent{ isTypedef ? EventKind::kTypedef : EventKind::kProperty, std::string(name) });
 
 	// Parse array
 	if (MatchSymbol("["))
@@ -672,12 +940,13 @@ bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
 			if(!GetIdentifier(arrayToken))
 				return false; // Expected a property name
 
-		writer_.arraySubscript(std::string(arrayToken.token));
+		writer_.arraySubscript(std::string(GetText(arrayToken)));
 
 		if(!MatchSymbol("]"))
 			return false;
 	}
 
+	openEvents_.pop_back();
 	if (isTypedef) {
 		writer_.endTypedef(name);
 	} else {
@@ -687,15 +956,16 @@ bool Parser::ParseProperty(Token &token, bool isTypedef, bool skipType)
 	// Skip until the end of the definition
 	Token t;
 	while(GetToken(t))
-		if(t.token == ";")
+		if(GetText(t) == ";")
 			break;
 
 	return true;
 }
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseUsing(Token& token)
+template<class Sink>
+bool Parser<Sink>::ParseUsing(Token& token)
 {
-	auto startLine = (unsigned)token.startLine;
+	auto startLine = (unsigned)GetLine(token.startPos);
 
 	WriteCurrentAccessControlType();
 
@@ -715,13 +985,14 @@ bool Parser::ParseUsing(Token& token)
 	// Skip until the end of the definition
 	Token t;
 	while (GetToken(t))
-		if (t.token == ";")
+		if (GetText(t) == ";")
 			break;
 
 	return true;
 }
 
-bool Parser::ParseFriend(Token& token)
+template<class Sink>
+bool Parser<Sink>::ParseFriend(Token& token)
 {
 	if (!ParseType()) {
 		return Error("Expected 'type' after 'friend'");
@@ -731,16 +1002,17 @@ bool Parser::ParseFriend(Token& token)
 
 	Token t;
 	while (GetToken(t))
-		if (t.token == ";")
+		if (GetText(t) == ";")
 			break;
 
 	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseFunction(Token &token, const Scope *scope)
+template<class Sink>
+bool Parser<Sink>::ParseFunction(Token &token, const Scope *scope)
 {
-	auto startLine = (unsigned)token.startLine;
+	auto startLine = (unsigned)GetLine(token.startPos);
 	
 	//if (token.tokenType == TokenType::kMacro) {
 	//	ParseMacro()
@@ -757,11 +1029,11 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 	bool isVirtual = false, isInline = false, isConstExpr = false, isStatic = false, isExplicit = false;
 	for(bool matched = true; matched;)
 	{
-		matched = (!isVirtual && (isVirtual = MatchIdentifier("virtual"))) ||
-				(!isInline && (isInline = MatchIdentifier("inline"))) ||
-				(!isConstExpr && (isConstExpr = MatchIdentifier("constexpr"))) ||
-				(!isExplicit && (isExplicit = MatchIdentifier("explicit"))) ||
-				(!isStatic && (isStatic = MatchIdentifier("static")));
+		matched = (!isVirtual && (isVirtual = MatchKeyword(Keyword::kVirtual))) ||
+				(!isInline && (isInline = MatchKeyword(Keyword::kInline))) ||
+				(!isConstExpr && (isConstExpr = MatchKeyword(Keyword::kConstExpr))) ||
+				(!isExplicit && (isExplicit = MatchKeyword(Keyword::kExplicit))) ||
+				(!isStatic && (isStatic = MatchKeyword(Keyword::kStatic)));
 	}
 
 	TypeNode::Type type;
@@ -788,7 +1060,7 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 		return Error("Expected identifier");
 	}
 
-	name = nameToken.token;
+	name = GetText(nameToken);
 	if (type == TypeNode::Type::kDestructor) {
 		name = std::string_view(name.data() - 1, name.length() + 1);
 	}
@@ -801,15 +1073,15 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 		if (operatorToken.tokenType != TokenType::kSymbol) {
 			return false;
 		}
-		name = std::string_view(name.data(), name.length() + operatorToken.token.length());
-		if (operatorToken.token == "(") {
+		name = std::string_view(name.data(), name.length() + GetText(operatorToken).length());
+		if (GetText(operatorToken) == "(") {
 			if (!GetToken(operatorToken)) {
 				return false;
 			}
-			if (operatorToken.token != ")") {
+			if (GetText(operatorToken) != ")") {
 				return Error("Expected ')'");
 			}
-			name = std::string_view(name.data(), name.length() + operatorToken.token.length());
+			name = std::string_view(name.data(), name.length() + GetText(operatorToken).length());
 		}
 	}
 
@@ -826,6 +1098,7 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 	specifiers.isStatic = isStatic;
 
 	writer_.beginFunction(startLine, TypeNode::Type::kFunction, name);
+	openEvents_.push_back(OpenEvent{ EventKind::kFunction, std::string(name) });
 
 	// Is there an argument list in the first place or is it closed right away?
 	if (!MatchSymbol(")"))
@@ -842,36 +1115,25 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 			// Parse the name of the function
 			std::string_view identifier;
 			if (GetIdentifier(nameToken)) {
-				identifier = nameToken.token;
+				identifier = GetText(nameToken);
 			}
 
 			std::string_view defaultValue;
 
 			// Parse default value
 			if (MatchSymbol("=")) {
-				Token token;
 				Token startToken;
 				GetToken(startToken);
 				UngetToken(startToken);
-				size_t closureCnt = 0;
-				while (GetToken(token)) {
-					if (closureCnt == 0 && (token.token == "," || token.token == ")")) {
-						UngetToken(token);
-						break;
-					}
-					if (token.token == "(") {
-						++closureCnt;
-					} else if (token.token == ")") {
-						--closureCnt;
-					}
-				}
 
+				// Jump over the value on the byte level, it is not tokenized any further
+				const size_t endPos = FindExpressionEnd();
 				if (startToken.tokenType == TokenType::kConst) {
-					defaultValue = startToken.token;
+					defaultValue = GetText(startToken);
 				} else {
-					defaultValue = std::string_view(startToken.token.data(), token.startPos - startToken.startPos);
+					defaultValue = std::string_view(GetText(startToken).data(), endPos - startToken.startPos);
 				}
-				defaultValue = defaultValue;
+				SetCursor(endPos);
 			}
 
 			writer_.functionArgument(identifier, defaultValue);
@@ -882,17 +1144,17 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 	
 	// Optionally parse constness
 	bool isConst = false;
-	if (MatchIdentifier("const")) {
+	if (MatchKeyword(Keyword::kConst)) {
 		isConst = true;
 	}
 
 	bool isOverride = false;
-	if (MatchIdentifier("override")) {
+	if (MatchKeyword(Keyword::kOverride)) {
 		isOverride = true;
 	}
 
 	bool isNoExcept = false;
-	if (MatchIdentifier("noexcept")) {
+	if (MatchKeyword(Keyword::kNoExcept)) {
 		isNoExcept = true;
 	}
 
@@ -902,14 +1164,14 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 	bool isDeleted = false;
 	Token equals;
 	if (MatchSymbol("=") && GetToken(equals)) {
-		if (equals.token == "0") {
+		if (GetText(equals) == "0") {
 			isAbstract = true;
-		} else if (equals.token == "default") {
+		} else if (equals.keyword == Keyword::kDefault) {
 			isDefault = true;
-		} else if (equals.token == "delete") {
+		} else if (equals.keyword == Keyword::kDelete) {
 			isDeleted = true;
 		} else {
-			return Error("Unexpected token '%s'", std::string(equals.token).c_str());
+			return Error("Unexpected token '%s'", std::string(GetText(equals)).c_str());
 		}
 	}
 
@@ -919,17 +1181,18 @@ bool Parser::ParseFunction(Token &token, const Scope *scope)
 	specifiers.isDefault = isDefault;
 	specifiers.isDeleted = isDeleted;
 
+	openEvents_.pop_back();
 	writer_.endFunction(name, specifiers);
 
 	// Skip either the ; or the body of the function
-	Token skipToken;
-	if (!SkipDeclaration(skipToken))
+	if (!SkipDeclaration())
 		return false;
 
 	return true;
 }
 
-TypeNode::Type Parser::PeekConstructor(const std::string_view& scopeName)
+template<class Sink>
+TypeNode::Type Parser<Sink>::PeekConstructor(const std::string_view& scopeName)
 {
 	TypeNode::Type type = TypeNode::Type::kConstructor;
 	Token token;
@@ -940,7 +1203,7 @@ TypeNode::Type Parser::PeekConstructor(const std::string_view& scopeName)
 	}
 
 	startToken = token;
-	if (token.tokenType == TokenType::kSymbol && token.token == "~") {
+	if (token.tokenType == TokenType::kSymbol && GetText(token) == "~") {
 		type = TypeNode::Type::kDestructor;
 		if (!GetToken(token)) {
 			UngetToken(startToken);
@@ -948,7 +1211,7 @@ TypeNode::Type Parser::PeekConstructor(const std::string_view& scopeName)
 		}
 	}
 
-	if (token.token != scopeName) {
+	if (GetText(token) != scopeName) {
 		UngetToken(startToken);
 		return TypeNode::Type::kNone;
 	}
@@ -963,9 +1226,15 @@ TypeNode::Type Parser::PeekConstructor(const std::string_view& scopeName)
 }
 
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseComment()
+template<class Sink>
+bool Parser<Sink>::ParseComment()
 {
-	std::string comment = lastComment_.endLine == cursorLine_ ? lastComment_.text : "";
+	// Only the comment on the line of the declaration is reported, its text is built on demand
+	if (lastComment_.length == 0 || GetLine(lastComment_.endPos) != GetLine(cursorPos_) || !writer_.needsComments())
+		return true;
+
+	std::string comment;
+	GetCommentText(lastComment_, comment);
 	if (!comment.empty())
 	{
 		writer_.comment(comment);
@@ -975,150 +1244,176 @@ bool Parser::ParseComment()
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Parser::ParseType(TypeNode::Type *type, bool visit, const std::string_view& constructorName, std::string_view *outName, bool inTemplate)
+template<class Sink>
+bool Parser<Sink>::ParseType(TypeNode::Type *type, bool visit, const std::string_view& constructorName, std::string_view *outName, bool inTemplate)
 {
-	std::unique_ptr<TypeNode> node = ParseTypeNode(constructorName, inTemplate);
-	if (node == nullptr)
-		return false;
+	// A declaration that turned out to be something else parsed the type at this position before
+	const std::size_t startPos = cursorPos_;
+	uint32_t node = TypeNode::kNoNode;
+	for (const auto& memo : typeMemos_) {
+		if (memo.startPos == startPos && memo.inTemplate == inTemplate && memo.constructorName == constructorName) {
+			node = memo.node;
+			SetCursorState(memo.end);
+			++typeMemoHits_;
+			break;
+		}
+	}
+
+	if (node == TypeNode::kNoNode) {
+		node = ParseTypeNode(constructorName, inTemplate);
+		if (node == TypeNode::kNoNode)
+			return false;
+		typeMemos_.push_back(TypeMemo{ startPos, constructorName, inTemplate, node, GetCursorState() });
+	}
+
 	if (visit) {
-		TypeNodeWriter writer(writer_);
-		writer.VisitNode(*node);
+		WriteType(node);
 	}
 	if (type) {
-		*type = node->type;
+		*type = typeNodes_[node].type;
 	}
-	if (outName) {
-		auto fn = dynamic_cast<FunctionNode*>(node.get());
-		if (fn) {
-			*outName = fn->name;
-		}
+	if (outName && (typeNodes_[node].type == TypeNode::Type::kFunction || typeNodes_[node].type == TypeNode::Type::kFunctionPointer)) {
+		*outName = typeNodes_[node].name;
 	}
 	return true;
 }
 
 //-------------------------------------------------------------------------------------------------
-std::unique_ptr<TypeNode> Parser::ParseTypeNode(const std::string_view &constructorName, bool inTemplate)
+template<class Sink>
+uint32_t Parser<Sink>::ParseTypeNode(const std::string_view &constructorName, bool inTemplate)
 {
-	std::unique_ptr<TypeNode> node;
+	++typeDepth_;
+	ScopeGuard depthGuard{ [&]() {
+		--typeDepth_;
+	} };
+	if (!CheckBudget())
+		return TypeNode::kNoNode;
+
+	uint32_t node;
 	Token token;
 
 	bool isConst = false, isVolatile = false, isMutable = false, isUnsigned = false;
 	for (bool matched = true; matched;)
 	{
-		matched = (!isConst && (isConst = MatchIdentifier("const")))
-				|| (!isVolatile && (isVolatile = MatchIdentifier("volatile")))
-				|| (!isMutable && (isMutable = MatchIdentifier("mutable")))
+		matched = (!isConst && (isConst = MatchKeyword(Keyword::kConst)))
+				|| (!isVolatile && (isVolatile = MatchKeyword(Keyword::kVolatile)))
+				|| (!isMutable && (isMutable = MatchKeyword(Keyword::kMutable)))
 		;
 	}
 
 	// parse signedness specifiers
 	SignednessSpecifier signedness = ParseSignednessSpecifier();
 	SizeSpecifier size = ParseSizeSpecifier();
-	std::string declarator;
+	std::string_view declarator;
 
 	if (signedness != SignednessSpecifier::kNone || size != SizeSpecifier::kNone) {
+		std::string& text = declarator_;
+		text.clear();
 		if (signedness != SignednessSpecifier::kNone) {
-			declarator.append(Signedness2String(signedness));
+			text.append(Signedness2String(signedness));
 		}
 		if (size != SizeSpecifier::kNone) {
-			if (!declarator.empty()) {
-				declarator.push_back(' ');
+			if (!text.empty()) {
+				text.push_back(' ');
 			}
-			declarator.append(Size2String(size));
+			text.append(Size2String(size));
 		}
 		// parse a C base type
 		if (ParseBaseType(token)) {
-			if (!declarator.empty()) {
-				declarator.push_back(' ');
+			if (!text.empty()) {
+				text.push_back(' ');
 			}
-			declarator.append(token.token);
+			text.append(GetText(token));
 		}
+		declarator = typeArena_.Store(text);
 	} else {
 		// Parse a literal value
 		if (!ParseTypeNodeDeclarator(declarator, constructorName, !inTemplate)) {
-			return nullptr;
+			return TypeNode::kNoNode;
 		}
 	}
 
 	// Postfix const specifier
-	isConst = isConst || MatchIdentifier("const");
+	isConst = isConst || MatchKeyword(Keyword::kConst);
 
 	// Template?
 	if (MatchSymbol("<"))
 	{
-		std::unique_ptr<TemplateNode> templateNode(new TemplateNode(declarator));
+		const uint32_t templateNode = NewTypeNode(TypeNode::Type::kTemplate, declarator);
+		uint32_t last = TypeNode::kNoNode;
 		do
 		{
-			auto node = ParseTypeNode(constructorName);
-			if (node == nullptr)
-				return nullptr;
+			const uint32_t argument = ParseTypeNode(constructorName);
+			if (argument == TypeNode::kNoNode)
+				return TypeNode::kNoNode;
 
-			templateNode->arguments.emplace_back(std::move(node));
+			AppendTypeNode(templateNode, last, argument);
+			last = argument;
 		} while (MatchSymbol(","));
 
-		if (!MatchSymbol(">"))
+		if (!MatchSymbol<LexMode::kSeparateBraces>(">"))
 		{
 			Error("Expected '>'");
-			return nullptr;
+			return TypeNode::kNoNode;
 		}
 
-		node.reset(templateNode.release());
+		node = templateNode;
 
 		if (MatchSymbol("::")) {
-			auto selector = ParseTypeNode(std::string_view());
-			if (!selector) {
+			const uint32_t selector = ParseTypeNode(std::string_view());
+			if (selector == TypeNode::kNoNode) {
 				Error("Expected type declarator");
-				return nullptr;
+				return TypeNode::kNoNode;
 			}
-			selector->parent = std::move(node);
-			node.reset(selector.release());
+			typeNodes_[selector].parent = node;
+			node = selector;
 		}
 	}
 	else
 	{
-		node.reset(new LiteralNode(declarator));
+		node = NewTypeNode(TypeNode::Type::kLiteral, declarator);
 		if (declarator.length() >= 3 && declarator.substr(declarator.length() - 3) == "...") {
-			node->type = TypeNode::Type::kVariadic;
-			return std::move(node);
+			typeNodes_[node].type = TypeNode::Type::kVariadic;
+			return node;
 		}
 		else if (declarator == constructorName) {
-			node->type = TypeNode::Type::kConstructor;
-			return std::move(node);
+			typeNodes_[node].type = TypeNode::Type::kConstructor;
+			return node;
 		}
-		else if (declarator[0] == '~') {
-			node->type = TypeNode::Type::kDestructor;
-			return std::move(node);
+		else if (!declarator.empty() && declarator[0] == '~') {
+			typeNodes_[node].type = TypeNode::Type::kDestructor;
+			return node;
 		}
 	}
 
 	// Store gathered stuff
-	node->specifiers.isConst = isConst;
-	node->signedness = signedness;
-	node->size = size;
+	typeNodes_[node].specifiers.isConst = isConst;
+	typeNodes_[node].signedness = signedness;
+	typeNodes_[node].size = size;
 
 	// Check reference or pointer types
 	while (GetToken(token))
 	{
-		if (token.token == "&")
-			node.reset(new ReferenceNode(std::move(node)));
-		else if (token.token == "&&")
-			node.reset(new LReferenceNode(std::move(node)));
-		else if (token.token == "*")
-			node.reset(new PointerNode(std::move(node)));
+		if (GetText(token) == "&")
+			node = NewTypeNode(TypeNode::Type::kReference, std::string_view(), node);
+		else if (GetText(token) == "&&")
+			node = NewTypeNode(TypeNode::Type::kLReference, std::string_view(), node);
+		else if (GetText(token) == "*")
+			node = NewTypeNode(TypeNode::Type::kPointer, std::string_view(), node);
 		else
 		{
 			UngetToken(token);
 			break;
 		}
 
-		if (MatchIdentifier("const"))
-			node->specifiers.isConst = true;
+		if (MatchKeyword(Keyword::kConst))
+			typeNodes_[node].specifiers.isConst = true;
 	}
 
 	// Function pointer?
 	if (MatchSymbol("("))
 	{
-		std::unique_ptr<FunctionNode> funcNode(new FunctionNode());
+		const uint32_t funcNode = NewTypeNode(TypeNode::Type::kFunction, std::string_view(), node);
 		// Parse void(*)(args, ...)
 		//            ^
 		//            |
@@ -1128,59 +1423,100 @@ std::unique_ptr<TypeNode> Parser::ParseTypeNode(const std::string_view &construc
 		bool hasTypedefEnd = hasTypedef && MatchSymbol(")") && MatchSymbol("(");
 
 		if (hasTypedef) {
-			funcNode->name = token.token;
+			typeNodes_[funcNode].name = GetText(token);
 		}
 		if (isFunctionPointer) {
-			funcNode->type = TypeNode::Type::kFunctionPointer;
+			typeNodes_[funcNode].type = TypeNode::Type::kFunctionPointer;
 		}
 
-		// Parse arguments
-		
-		funcNode->returns = std::move(node);
-
+		// Parse arguments, they follow the return type
 		if (!MatchSymbol(")"))
 		{
+			uint32_t last = node;
 			do
 			{
-				std::unique_ptr<FunctionNode::Argument> argument(new FunctionNode::Argument);
-				argument->type = ParseTypeNode(std::string());
-				if (argument->type == nullptr)
-					return nullptr;
+				const uint32_t argument = ParseTypeNode(std::string_view());
+				if (argument == TypeNode::kNoNode)
+					return TypeNode::kNoNode;
 
 				// Get , or name identifier
 				if (!GetToken(token))
 				{
 					Error("Unexpected end of file");
-					return nullptr;
+					return TypeNode::kNoNode;
 				}
 
 				// Parse optional name
 				if (token.tokenType == TokenType::kIdentifier)
-					argument->name = token.token;
+					typeNodes_[argument].argumentName = GetText(token);
 				else
 					UngetToken(token);
 
-				funcNode->arguments.emplace_back(std::move(argument));
+				AppendTypeNode(funcNode, last, argument);
+				last = argument;
 
 			} while (MatchSymbol(","));
 			if (!MatchSymbol(")")) {
 				Error("Expected ')'");
-				return nullptr;
+				return TypeNode::kNoNode;
 			}
 		}
 
-		node = std::move(funcNode);
+		node = funcNode;
 	}
 
 	// This stuff refers to the top node
-	node->specifiers.isVolatile = isVolatile;
-	node->specifiers.isMutable = isMutable;
+	typeNodes_[node].specifiers.isVolatile = isVolatile;
+	typeNodes_[node].specifiers.isMutable = isMutable;
+
+	return node;
+}
 
-	return std::move(node);
+//-------------------------------------------------------------------------------------------------
+template<class Sink>
+uint32_t Parser<Sink>::NewTypeNode(TypeNode::Type type, const std::string_view& name, uint32_t child)
+{
+	const uint32_t node = uint32_t(typeNodes_.size());
+	typeNodes_.emplace_back(type);
+	typeNodes_[node].name = name;
+	if (child != TypeNode::kNoNode) {
+		typeNodes_[node].child = child;
+		typeNodes_[child].owner = node;
+	}
+	return node;
 }
 
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseTypeNodeDeclarator(std::string &declarator, const std::string_view& constructorName, bool checkSpecifier)
+template<class Sink>
+void Parser<Sink>::WriteType(uint32_t node)
+{
+	// Types that were seen before cost a lookup instead of building their spelling
+	if (types_ != nullptr && !writer_.needsTypeNodes()) {
+		const TypeTable::Entry& entry = types_->Intern(typeNodes_, node, typeKey_);
+		writer_.internedType(entry.id, entry.spelling);
+		return;
+	}
+
+	TypeNodeWriter<Sink> writer(writer_);
+	writer.Write(typeNodes_, node);
+}
+
+//-------------------------------------------------------------------------------------------------
+template<class Sink>
+void Parser<Sink>::AppendTypeNode(uint32_t owner, uint32_t last, uint32_t node)
+{
+	typeNodes_[node].owner = owner;
+	if (last == TypeNode::kNoNode) {
+		typeNodes_[owner].child = node;
+	} else {
+		typeNodes_[last].next = node;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------
+template<class Sink>
+bool Parser<Sink>::ParseTypeNodeDeclarator(std::string_view &name, const std::string_view& constructorName, bool checkSpecifier)
 {
 	// optional forward declaration specifier
 	Token specifier;
@@ -1188,14 +1524,26 @@ bool Parser::ParseTypeNodeDeclarator(std::string &declarator, const std::string_
 		return false;
 	}
 
+	// The name is a view of the source if it is spelled the same way there, a copy in the arena otherwise
+	std::string& declarator = declarator_;
+	declarator.clear();
+	const std::size_t start = specifier.startPos;
+	auto store = [&]() {
+		if (start + declarator.length() <= inputLength_ && declarator.compare(0, declarator.length(), input_ + start, declarator.length()) == 0)
+			name = std::string_view(input_ + start, declarator.length());
+		else
+			name = typeArena_.Store(declarator);
+		return true;
+	};
+
 	bool hasSpecifier = false;
 	if (checkSpecifier) {
-		hasSpecifier = isSpecifier(specifier.token);
+		hasSpecifier = isSpecifier(specifier.keyword);
 	}
 	if (!hasSpecifier) {
 		UngetToken(specifier);
 	} else {
-		declarator = specifier.token;
+		declarator = GetText(specifier);
 	}
 
 	// Parse a type name
@@ -1207,23 +1555,23 @@ bool Parser::ParseTypeNodeDeclarator(std::string &declarator, const std::string_
 		// Parse the declarator
 		if (MatchSymbol("...")) {
 			declarator.append("...");
-			return true;
+			return store();
 		}
 		else if (MatchSymbol("~")) {
 			Token token;
 			if (!GetIdentifier(token)) {
 				return Error("Identifier expected");
 			}
-			if (token.token != constructorName) {
+			if (GetText(token) != constructorName) {
 				return Error("Invalid destructor name");
 			}
-			declarator = std::string("~").append(token.token);
+			declarator.assign("~").append(GetText(token));
 			if (!RequireSymbol("(")) {
 				return false;
 			}
 			UngetToken(token);
 			--cursorPos_;
-			return true;
+			return store();
 		}
 		else if (MatchSymbol("::")) {
 			declarator += "::";
@@ -1237,11 +1585,11 @@ bool Parser::ParseTypeNodeDeclarator(std::string &declarator, const std::string_
 
 		// Match an identifier or constant
 		if (GetIdentifier(token)) {
-			if (token.token == constructorName) {
+			if (GetText(token) == constructorName) {
 				if (MatchSymbol("(")) {
 					UngetToken(token);
-					declarator = constructorName;
-					return true;
+					declarator.assign(constructorName);
+					return store();
 				}
 			}
 			UngetToken(token);
@@ -1249,73 +1597,83 @@ bool Parser::ParseTypeNodeDeclarator(std::string &declarator, const std::string_
 		if (!GetIdentifier(token) && !GetConst(token))
 			return false;
 
-		declarator += token.token;
+		declarator += GetText(token);
 
 	} while (true);
 
-	return true;
+	return store();
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 /*
 void Parser::WriteToken(const Token& token)
 {
-	if(token.tokenType == TokenType::kConst)
+	ConstValue value;
+	if(token.tokenType == TokenType::kConst && token.constType == ConstType::kString)
+	{
+		std::string str;
+		GetString(token, str);
+		//writer_.String((std::string("\"") + str + "\"").c_str());
+		writer_.constant(str);
+	}
+	else if(GetConstValue(token, value))
 	{
-		switch(token.constType)
+		switch(value.constType)
 		{
 		case ConstType::kBoolean:
-			writer_.constant(token.boolConst);
+			writer_.constant(value.boolConst);
 			break;
 		case ConstType::kUInt32:
-			writer_.constant(token.uint32Const);
+			writer_.constant(value.uint32Const);
 			break;
 		case ConstType::kInt32:
-			writer_.constant(token.int32Const);
+			writer_.constant(value.int32Const);
 			break;
 		case ConstType::kUInt64:
-			writer_.constant(token.uint64Const);
+			writer_.constant(value.uint64Const);
 			break;
 		case ConstType::kInt64:
-			writer_.constant(token.int64Const);
+			writer_.constant(value.int64Const);
 			break;
 		case ConstType::kReal:
-			writer_.constant(token.realConst);
+			writer_.constant(value.realConst);
 			break;
-		case ConstType::kString:
-			//writer_.String((std::string("\"") + token.stringConst + "\"").c_str());
-			writer_.constant(token.stringConst);
+		default:
 			break;
 		}
 	}
 	else
-		writer_.constant(token.token);
+		writer_.constant(GetText(token));
 }
 */
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseTemplate()
+template<class Sink>
+bool Parser<Sink>::ParseTemplate()
 {
 	if(!RequireSymbol("<"))
 		return false;
 
 	writer_.beginTemplate();
-	if (!MatchSymbol(">")) {
+	openEvents_.push_back(OpenEvent{ EventKind::kTemplate, std::string() });
+	if (!MatchSymbol<LexMode::kSeparateBraces>(">")) {
 		do
 		{
 			if (!ParseTemplateArgument())
 				return false;
 		} while (MatchSymbol(","));
 
-		if (!RequireSymbol(">"))
+		if (!RequireSymbol<LexMode::kSeparateBraces>(">"))
 			return false;
 	}
 
+	openEvents_.pop_back();
 	writer_.endTemplate();
 	return true;
 }
 
 //-------------------------------------------------------------------------------------------------
-bool Parser::ParseTemplateArgument()
+template<class Sink>
+bool Parser<Sink>::ParseTemplateArgument()
 {
 	Token token;
 	if (!ParseType(nullptr, true, std::string_view(), nullptr, true)) {
@@ -1325,7 +1683,7 @@ bool Parser::ParseTemplateArgument()
 	// Parse the template argument name
 	std::string_view name;
 	if (GetIdentifier(token)) {
-		name = token.token;
+		name = GetText(token);
 	}
 
 	// Optionally check if there is a default initializer
@@ -1342,12 +1700,33 @@ bool Parser::ParseTemplateArgument()
 	return true;
 }
 
-std::string Parser::GenerateUnnamedIdentifier(const std::string_view &type)
+template<class Sink>
+std::string Parser<Sink>::GenerateUnnamedIdentifier(const std::string_view &type)
 {
 	return std::string("unnamed-").append(type).append(std::to_string(m_unnamedCnt++));
 }
 
-void Parser::SetInterface(ParserInterface& i)
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+void Parser<Sink>::SetDefineTable(const DefineTable* defines)
+{
+	defines_ = defines;
+}
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+void Parser<Sink>::SetTypeTable(TypeTable* types)
 {
-	writer_ = i;
+	types_ = types;
 }
+
+//--------------------------------------------------------------------------------------------------
+template<class Sink>
+void Parser<Sink>::SetAnnotationsOnly(bool annotationsOnly)
+{
+	annotationsOnly_ = annotationsOnly;
+}
+
+// Any ParserInterface through virtual calls, and the synchronizer every worker writes to with direct calls
+template class Parser<ParserInterface>;
+template class Parser<ParserInterfaceSynchronizer>;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "arena.h"
 #include "tokenizer.h"
 #include "type_node.h"
 #include <string>
@@ -7,11 +8,16 @@
 #include <deque>
 
 #include "parser_interface.h"
+#include "preprocessor.h"
+#include "type_table.h"
 
+/// Parses C++ headers into the events of Sink. Sink is ParserInterface or a class derived from it, the events are
+/// called on the static type, a final sink gets them without virtual calls. The instantiations are in parser.cc.
+template<class Sink = ParserInterface>
 class Parser : private Tokenizer
 {
 public:
-	Parser(ParserInterface &interface);
+	Parser(Sink &sink);
 	virtual ~Parser();
 
 	// No copying of parser
@@ -21,10 +27,42 @@ public:
 	// Parses the given input
 	bool Parse(const std::string_view& fileName, const std::string_view &input);
 
-	void SetInterface(ParserInterface& interface);
+	/// Sets the macro values conditional directives are evaluated against, the table must outlive the parser
+	void SetDefineTable(const DefineTable* defines);
+
+	/// Sets the table types are interned in for sinks that only need their spelling, the table must outlive the parser
+	void SetTypeTable(TypeTable* types);
+
+	/// Only parses declarations that follow a known macro, together with the namespaces and classes they are in.
+	/// Everything else is skipped on the byte level.
+	void SetAnnotationsOnly(bool annotationsOnly);
 
 	using Tokenizer::GetError;
 	using Tokenizer::AddMacro;
+	using Tokenizer::SetMacroTable;
+	using Tokenizer::GetTokensLexed;
+	using Tokenizer::GetTokenCacheHits;
+	using Tokenizer::GetBytesLexed;
+	using Tokenizer::GetBytesRelexed;
+
+	/// Returns the number of types that were not parsed again because they were parsed at the same position before
+	std::size_t GetTypeMemoHits() const { return typeMemoHits_; }
+	using Tokenizer::SetTokenStream;
+
+	/// A declaration that was skipped because parsing it took too much work
+	struct BudgetDiagnostic
+	{
+		std::size_t line;
+
+		/// "re-lex" if the file re-lexed more bytes than its budget allows, "depth" if a type was nested too deeply
+		const char* reason;
+
+		std::size_t bytesRelexed;
+		std::size_t typeDepth;
+	};
+
+	/// Returns the declarations of the last parsed file that were skipped because they exceeded the budget
+	const std::vector<BudgetDiagnostic>& GetBudgetDiagnostics() const { return budgetDiagnostics_; }
 
 protected:
 	struct Scope
@@ -34,14 +72,52 @@ protected:
 		AccessControlType currentAccessControlType;
 	};
 
+	/// A begin event that was written without its end event yet
+	enum class EventKind
+	{
+		kEnum,
+		kClass,
+		kNamespace,
+		kTemplate,
+		kTypedef,
+		kProperty,
+		kFunction
+	};
+
+	struct OpenEvent
+	{
+		EventKind kind;
+		std::string name;
+	};
+
 	/// Called to parse the next statement. Returns false if there are no more statements.
 	bool ParseBaseType(Token &baseType);
 	SignednessSpecifier ParseSignednessSpecifier();
 	SizeSpecifier ParseSizeSpecifier();
 	bool ParseStatement();
 	bool ParseDeclaration(Token &token);
+	bool SkipUnannotated(const Token &token);
 	bool ParseDirective();
-	bool SkipDeclaration(Token &token);
+	bool ParseConditional(const std::string_view& directive);
+	MacroValue FindMacro(const std::string_view& name) const;
+
+	/// Returns true if one of the open conditionals is in a branch that may be inactive
+	bool InUnknownBranch() const;
+
+	/// Skips to the end of the current declaration, returns false if the end of the file was reached first
+	bool SkipDeclaration();
+
+	/// Skips the declaration starting at token if parsing it exceeded the budget since diagnosticCount diagnostics were
+	/// recorded. The events and scopes the declaration left open are closed first, down to openEventCount and
+	/// scopeCount, and the error is reset to the one before the declaration if hadError is set or cleared otherwise.
+	/// Returns false if the declaration failed for another reason.
+	bool SkipOverBudget(Token &token, std::size_t diagnosticCount, std::size_t openEventCount, std::size_t scopeCount, bool hadError);
+
+	/// Writes the end events of the open events after the first count ones, innermost first
+	void CloseEvents(std::size_t count);
+
+	/// Returns false and records a diagnostic if the current type is nested too deeply or the file re-lexed too much
+	bool CheckBudget();
 	bool ParseProperty(Token &token, bool isTypedef = false, bool skipType = false);
 	bool ParseEnum(Token &token);
 	bool ParseUsing(Token &token);
@@ -66,17 +142,99 @@ protected:
 
 	bool ParseType(TypeNode::Type *type = nullptr, bool visit = true, const std::string_view& constructorName = std::string_view(), std::string_view *outName = nullptr, bool inTemplate = false);
 
-	std::unique_ptr<TypeNode> ParseTypeNode(const std::string_view& constructorName, bool inTemplate = false);
-	bool ParseTypeNodeDeclarator(std::string &declarator, const std::string_view& constructorName, bool checkSpecifier = true);
+	/// Parses a type into typeNodes_ and returns the index of its top node, or TypeNode::kNoNode on failure.
+	/// The nodes stay valid until the next statement is parsed.
+	uint32_t ParseTypeNode(const std::string_view& constructorName, bool inTemplate = false);
+	bool ParseTypeNodeDeclarator(std::string_view &name, const std::string_view& constructorName, bool checkSpecifier = true);
+
+	/// Adds a node to typeNodes_, child is the base of a pointer or reference or the return type of a function
+	uint32_t NewTypeNode(TypeNode::Type type, const std::string_view& name, uint32_t child = TypeNode::kNoNode);
+
+	/// Adds node to the children of owner after last, the previous child or TypeNode::kNoNode for the first one
+	void AppendTypeNode(uint32_t owner, uint32_t last, uint32_t node);
+
+	/// Sends the type starting at node to the writer, as type events or as its interned spelling
+	void WriteType(uint32_t node);
 
 	//void WriteToken(const Token &token);
 
 private:
-	ParserInterface& writer_;
+	Sink& writer_;
 
 	std::deque<Scope> scopes_;
 	unsigned m_unnamedCnt;
 
+	/// The begin events written without their end event, outermost first
+	std::vector<OpenEvent> openEvents_;
+
+	/// State of an open #if, taken is set once one of its branches is known to be active.
+	/// unknown is set once one of its branches had an unknown condition, the branches from there on may be inactive.
+	struct Conditional
+	{
+		bool taken;
+		bool unknown;
+	};
+
+	std::vector<Conditional> conditionals_;
+	const DefineTable* defines_;
+
+	/// Macros removed by #undef or defined in a branch that may be inactive, their state is unknown from then on
+	MacroTable unknownMacros_;
+
+	bool annotationsOnly_;
+
+	/// Set while an annotated declaration is parsed, its members are parsed whether they are annotated or not
+	bool inAnnotation_;
+
+	/// Nodes of the types of the current statement
+	std::vector<TypeNode> typeNodes_;
+
+	/// A type parsed by ParseType, keyed by its start position and the arguments that change how it is parsed
+	struct TypeMemo
+	{
+		std::size_t startPos;
+		std::string_view constructorName;
+		bool inTemplate;
+
+		uint32_t node;
+
+		/// The tokenizer state after the type
+		CursorState end;
+	};
+
+	/// The types of the current statement, so a declaration that is parsed again as something else reuses them
+	std::vector<TypeMemo> typeMemos_;
+	std::size_t typeMemoHits_;
+
+	/// Type names of the current statement that are not spelled like that in the source
+	Arena typeArena_;
+
+	/// Scratch buffer for type names that are built from several tokens
+	std::string declarator_;
+
+	TypeTable* types_;
+
+	/// Scratch buffer for the keys of interned types
+	std::string typeKey_;
+
+	/// A file may re-lex twice its size plus some slack, a declaration that re-lexes beyond that is skipped
+	static const std::size_t kRelexFactor = 2;
+	static const std::size_t kRelexSlack = 4096;
+
+	/// Types nested deeper than this are not parsed, their declaration is skipped
+	static const std::size_t kMaxTypeDepth = 256;
+
+	/// The number of ParseTypeNode calls that are active
+	std::size_t typeDepth_;
+
+	/// The re-lexed bytes when the current statement started, a statement that does not re-lex is never skipped
+	std::size_t relexedAtStatement_;
+
+	std::vector<BudgetDiagnostic> budgetDiagnostics_;
+
+	/// The error when the budget last stopped a declaration, SkipOverBudget puts it back
+	std::string errorAtBudget_;
+
 	bool ParseTemplateArgument();
 	std::string GenerateUnnamedIdentifier(const std::string_view &name);
 };
@@ -29,6 +29,8 @@ public:
 
 	virtual void include(const std::string_view& filename) = 0;
 	virtual void comment(const std::string_view& comment) = 0;
+	/// Returns false if comment() ignores its argument, the parser then doesn't build the comment texts
+	virtual bool needsComments() const { return true; }
 	virtual void access(AccessControlType act) = 0;
 	virtual void using_(bool hasAssigment) = 0;
 	virtual void friend_() = 0;
@@ -52,6 +54,11 @@ public:
 	virtual void typeName(const std::string_view& name) = 0;
 	virtual void endType() = 0;
 
+	/// Returns false if the sink only needs the spelling of types. If the parser has a type table, it then calls
+	/// internedType() in place of the beginType() ... endType() events of every type.
+	virtual bool needsTypeNodes() const { return true; }
+	virtual void internedType(TypeId /*id*/, const std::string_view& /*spelling*/) {}
+
 	virtual void beginProperty(int startLine, const std::string_view& name, Specifiers specifiers) = 0;
 	virtual void arraySubscript(const std::string_view& name) = 0;
 	virtual void endProperty(const std::string_view& name) = 0;
@@ -0,0 +1,341 @@
+#include "preprocessor.h"
+#include "scanner.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+	/// Parses an integer literal with an optional 0x, 0b or octal prefix and integer suffixes
+	bool ParseInteger(const std::string_view& text, int64_t& value)
+	{
+		// Integer suffixes do not change the value
+		std::size_t end = text.length();
+		while (end > 0 && std::string_view("uUlL").find(text[end - 1]) != std::string_view::npos)
+			--end;
+
+		int base = 10;
+		std::size_t digits = 0;
+		if (end > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+		{
+			base = 16;
+			digits = 2;
+		}
+		else if (end > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+		{
+			base = 2;
+			digits = 2;
+		}
+		else if (end > 1 && text[0] == '0')
+		{
+			base = 8;
+			digits = 1;
+		}
+
+		const char* last = text.data() + end;
+		const auto result = std::from_chars(text.data() + digits, last, value, base);
+		return digits < end && result.ec == std::errc() && result.ptr == last;
+	}
+
+	/// The value of a sub expression, unknown if it depends on a macro with an unknown value
+	struct Operand
+	{
+		bool known;
+		int64_t value;
+	};
+
+	/// Recursive descent over the expression of a conditional directive
+	class ConditionParser
+	{
+	public:
+		ConditionParser(const std::string_view& expression, const MacroLookup& lookup) :
+			expression_(expression),
+			lookup_(lookup),
+			pos_(0),
+			failed_(false)
+		{
+		}
+
+		Condition Evaluate()
+		{
+			const Operand result = ParseOr();
+			SkipWhitespace();
+			if (failed_ || pos_ != expression_.length() || !result.known)
+				return Condition::kUnknown;
+			return result.value != 0 ? Condition::kTrue : Condition::kFalse;
+		}
+
+	private:
+		Operand ParseOr()
+		{
+			Operand left = ParseAnd();
+			while (Match("||"))
+			{
+				const Operand right = ParseAnd();
+				if ((left.known && left.value != 0) || (right.known && right.value != 0))
+					left = Operand{ true, 1 };
+				else
+					left = Operand{ left.known && right.known, 0 };
+			}
+			return left;
+		}
+
+		Operand ParseAnd()
+		{
+			Operand left = ParseComparison();
+			while (Match("&&"))
+			{
+				const Operand right = ParseComparison();
+				if ((left.known && left.value == 0) || (right.known && right.value == 0))
+					left = Operand{ true, 0 };
+				else
+					left = Operand{ left.known && right.known, 1 };
+			}
+			return left;
+		}
+
+		Operand ParseComparison()
+		{
+			Operand left = ParseUnary();
+			for (;;)
+			{
+				int op;
+				if (Match("=="))
+					op = 0;
+				else if (Match("!="))
+					op = 1;
+				else if (Match("<="))
+					op = 2;
+				else if (Match(">="))
+					op = 3;
+				else if (Match("<"))
+					op = 4;
+				else if (Match(">"))
+					op = 5;
+				else
+					return left;
+
+				const Operand right = ParseUnary();
+				if (!left.known || !right.known)
+				{
+					left = Operand{ false, 0 };
+					continue;
+				}
+
+				bool result = false;
+				switch (op)
+				{
+				case 0: result = left.value == right.value; break;
+				case 1: result = left.value != right.value; break;
+				case 2: result = left.value <= right.value; break;
+				case 3: result = left.value >= right.value; break;
+				case 4: result = left.value < right.value; break;
+				case 5: result = left.value > right.value; break;
+				}
+				left = Operand{ true, result ? 1 : 0 };
+			}
+		}
+
+		Operand ParseUnary()
+		{
+			if (Match("!"))
+			{
+				const Operand operand = ParseUnary();
+				return Operand{ operand.known, operand.value == 0 ? 1 : 0 };
+			}
+
+			if (Match("("))
+			{
+				const Operand operand = ParseOr();
+				if (!Match(")"))
+					failed_ = true;
+				return operand;
+			}
+
+			SkipWhitespace();
+			if (pos_ >= expression_.length())
+			{
+				failed_ = true;
+				return Operand{ false, 0 };
+			}
+
+			const char c = expression_[pos_];
+			if (c >= '0' && c <= '9')
+				return ParseNumber();
+
+			const std::string_view name = ParseIdentifier();
+			if (name.empty())
+			{
+				failed_ = true;
+				return Operand{ false, 0 };
+			}
+
+			if (name == "defined")
+			{
+				const bool hasParenthesis = Match("(");
+				const std::string_view macro = ParseIdentifier();
+				if (macro.empty() || (hasParenthesis && !Match(")")))
+				{
+					failed_ = true;
+					return Operand{ false, 0 };
+				}
+
+				const Condition defined = lookup_(macro).defined;
+				return Operand{ defined != Condition::kUnknown, defined == Condition::kTrue ? 1 : 0 };
+			}
+
+			if (name == "true")
+				return Operand{ true, 1 };
+			if (name == "false")
+				return Operand{ true, 0 };
+
+			// Function like macros can not be evaluated
+			if (Peek('('))
+			{
+				failed_ = true;
+				return Operand{ false, 0 };
+			}
+
+			// Macros that are not defined evaluate to 0
+			const MacroValue macro = lookup_(name);
+			if (macro.defined == Condition::kFalse)
+				return Operand{ true, 0 };
+			if (macro.defined == Condition::kTrue && macro.hasValue)
+				return Operand{ true, macro.value };
+			return Operand{ false, 0 };
+		}
+
+		Operand ParseNumber()
+		{
+			const std::size_t start = pos_;
+			pos_ += ScanIdentifier(expression_.data() + pos_, expression_.length() - pos_);
+
+			int64_t value = 0;
+			if (!ParseInteger(expression_.substr(start, pos_ - start), value))
+			{
+				failed_ = true;
+				return Operand{ false, 0 };
+			}
+			return Operand{ true, value };
+		}
+
+		std::string_view ParseIdentifier()
+		{
+			SkipWhitespace();
+			if (pos_ >= expression_.length())
+				return std::string_view();
+
+			const char c = expression_[pos_];
+			if (!((c | 0x20) >= 'a' && (c | 0x20) <= 'z') && c != '_')
+				return std::string_view();
+
+			const std::size_t start = pos_;
+			pos_ += ScanIdentifier(expression_.data() + pos_, expression_.length() - pos_);
+			return expression_.substr(start, pos_ - start);
+		}
+
+		bool Match(const std::string_view& symbol)
+		{
+			SkipWhitespace();
+			if (expression_.compare(pos_, symbol.length(), symbol) != 0)
+				return false;
+
+			// Do not take the first character of a longer operator
+			if (symbol.length() == 1 && pos_ + 1 < expression_.length())
+			{
+				const char next = expression_[pos_ + 1];
+				if ((symbol[0] == '!' || symbol[0] == '<' || symbol[0] == '>') && next == '=')
+					return false;
+			}
+
+			pos_ += symbol.length();
+			return true;
+		}
+
+		bool Peek(char c)
+		{
+			SkipWhitespace();
+			return pos_ < expression_.length() && expression_[pos_] == c;
+		}
+
+		void SkipWhitespace()
+		{
+			while (pos_ < expression_.length())
+			{
+				const char c = expression_[pos_];
+				if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\\')
+					++pos_;
+				else if (expression_.compare(pos_, 2, "//") == 0)
+					pos_ = expression_.length();
+				else if (expression_.compare(pos_, 2, "/*") == 0)
+				{
+					const std::size_t end = expression_.find("*/", pos_ + 2);
+					pos_ = end == std::string_view::npos ? expression_.length() : end + 2;
+				}
+				else
+					break;
+			}
+		}
+
+		std::string_view expression_;
+		const MacroLookup& lookup_;
+		std::size_t pos_;
+		bool failed_;
+	};
+}
+
+//--------------------------------------------------------------------------------------------------
+DefineTable::DefineTable() :
+	strict_(false)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+DefineTable::DefineTable(const std::vector<std::string>& defines, bool strict) :
+	strict_(strict)
+{
+	for (const auto& define : defines)
+	{
+		const std::size_t equals = define.find('=');
+		const std::string name = define.substr(0, equals);
+		if (name.empty())
+			continue;
+
+		// Values that are no integers still define the macro
+		MacroValue value{ Condition::kTrue, true, 1 };
+		if (equals != std::string::npos)
+		{
+			value.value = 0;
+			value.hasValue = ParseInteger(std::string_view(define).substr(equals + 1), value.value);
+		}
+
+		// Later entries override earlier ones
+		auto it = std::find_if(defines_.begin(), defines_.end(), [&](const auto& define) { return define.first == name; });
+		if (it != defines_.end())
+			it->second = value;
+		else
+			defines_.emplace_back(name, value);
+	}
+
+	std::sort(defines_.begin(), defines_.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+//--------------------------------------------------------------------------------------------------
+MacroValue DefineTable::Find(const std::string_view& name) const
+{
+	const auto it = std::lower_bound(defines_.cbegin(), defines_.cend(), name, [](const auto& define, const std::string_view& name) {
+		return std::string_view(define.first) < name;
+	});
+	if (it != defines_.cend() && it->first == name)
+		return it->second;
+
+	return MacroValue{ strict_ ? Condition::kFalse : Condition::kUnknown, false, 0 };
+}
+
+//--------------------------------------------------------------------------------------------------
+Condition EvaluateCondition(const std::string_view& expression, const MacroLookup& lookup)
+{
+	ConditionParser parser(expression, lookup);
+	return parser.Evaluate();
+}
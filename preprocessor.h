@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Result of evaluating a conditional directive. Conditions that depend on macros the parser knows nothing
+/// about are unknown, both branches of them are parsed like before.
+enum class Condition : uint8_t
+{
+	kFalse,
+	kTrue,
+	kUnknown
+};
+
+/// What the parser knows about a macro used in a condition
+struct MacroValue
+{
+	Condition defined;
+
+	/// Set if the value of the macro is a known integer
+	bool hasValue;
+	int64_t value;
+};
+
+/// Returns what is known about the macro with the given name
+typedef std::function<MacroValue(const std::string_view& name)> MacroLookup;
+
+/// Macros with integer values given on the command line, like -D does for a compiler.
+/// The table is not modified after it is built and can be shared by all parsers.
+class DefineTable
+{
+public:
+	DefineTable();
+
+	/// Builds the table from entries of the form NAME or NAME=VALUE, NAME alone defines the macro as 1.
+	/// If strict is set, macros that are neither in the table nor defined otherwise are treated as undefined.
+	DefineTable(const std::vector<std::string>& defines, bool strict);
+
+	/// Returns what the table knows about the macro
+	MacroValue Find(const std::string_view& name) const;
+
+	bool IsStrict() const { return strict_; }
+
+private:
+	/// Names with their value, sorted by name
+	std::vector<std::pair<std::string, MacroValue>> defines_;
+
+	bool strict_;
+};
+
+/// Evaluates the expression of an #if or #elif directive. Supports integers, macros, defined(),
+/// parentheses, !, comparisons, && and ||. Anything else makes the condition unknown.
+Condition EvaluateCondition(const std::string_view& expression, const MacroLookup& lookup);
@@ -0,0 +1,377 @@
+#include "scanner.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define SCANNER_TARGET_SSE2
+#define SCANNER_TARGET_AVX2
+#else
+#define SCANNER_TARGET_SSE2 __attribute__((target("sse2")))
+#define SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+	//----------------------------------------------------------------------------------------------
+	// Scalar kernels, also used for the tails of the vector kernels
+	//----------------------------------------------------------------------------------------------
+	inline bool IsWhitespaceByte(unsigned char c)
+	{
+		return c <= 0x20 || c == 0x7F;
+	}
+
+	inline bool IsIdentifierByte(unsigned char c)
+	{
+		return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_';
+	}
+
+	std::size_t WhitespaceScalar(const char* str, std::size_t size)
+	{
+		std::size_t i = 0;
+		while (i < size && IsWhitespaceByte(str[i]))
+			++i;
+		return i;
+	}
+
+	std::size_t IdentifierScalar(const char* str, std::size_t size)
+	{
+		std::size_t i = 0;
+		while (i < size && IsIdentifierByte(str[i]))
+			++i;
+		return i;
+	}
+
+	std::size_t UntilAnyScalar(const char* str, std::size_t size, char a, char b, char c, char d)
+	{
+		std::size_t i = 0;
+		while (i < size && str[i] != a && str[i] != b && str[i] != c && str[i] != d)
+			++i;
+		return i;
+	}
+
+	inline bool IsStructuralByte(char c)
+	{
+		switch (c) {
+		case '{': case '}': case '(': case ')': case '<': case '>':
+		case ';': case ',': case ':': case '=': case '#':
+		case '"': case '\'': case '/':
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void StructuralScalar(const char* str, std::size_t size, uint64_t& structural, uint64_t& newLines)
+	{
+		structural = 0;
+		newLines = 0;
+		for (std::size_t i = 0; i < size; ++i) {
+			if (IsStructuralByte(str[i]))
+				structural |= uint64_t(1) << i;
+			else if (str[i] == '\n')
+				newLines |= uint64_t(1) << i;
+		}
+	}
+
+#ifdef SCANNER_X86
+	//----------------------------------------------------------------------------------------------
+	// SSE2 kernels, 16 bytes per step
+	//----------------------------------------------------------------------------------------------
+	SCANNER_TARGET_SSE2 std::size_t WhitespaceSSE2(const char* str, std::size_t size)
+	{
+		const __m128i space = _mm_set1_epi8(0x20);
+		const __m128i del = _mm_set1_epi8(0x7F);
+
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			const __m128i skip = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v), _mm_cmpeq_epi8(v, del));
+			const uint32_t stop = ~uint32_t(_mm_movemask_epi8(skip)) & 0xFFFFu;
+			if (stop)
+				return i + LowestBit(stop);
+		}
+		return i + WhitespaceScalar(str + i, size - i);
+	}
+
+	SCANNER_TARGET_SSE2 inline __m128i InRangeSSE2(__m128i v, char lo, char hi)
+	{
+		const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+		return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(char(hi - lo))), shifted);
+	}
+
+	SCANNER_TARGET_SSE2 std::size_t IdentifierSSE2(const char* str, std::size_t size)
+	{
+		const __m128i lowerCase = _mm_set1_epi8(0x20);
+		const __m128i underscore = _mm_set1_epi8('_');
+
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			const __m128i letter = InRangeSSE2(_mm_or_si128(v, lowerCase), 'a', 'z');
+			const __m128i match = _mm_or_si128(_mm_or_si128(letter, InRangeSSE2(v, '0', '9')), _mm_cmpeq_epi8(v, underscore));
+			const uint32_t stop = ~uint32_t(_mm_movemask_epi8(match)) & 0xFFFFu;
+			if (stop)
+				return i + LowestBit(stop);
+		}
+		return i + IdentifierScalar(str + i, size - i);
+	}
+
+	SCANNER_TARGET_SSE2 std::size_t UntilAnySSE2(const char* str, std::size_t size, char a, char b, char c, char d)
+	{
+		const __m128i va = _mm_set1_epi8(a);
+		const __m128i vb = _mm_set1_epi8(b);
+		const __m128i vc = _mm_set1_epi8(c);
+		const __m128i vd = _mm_set1_epi8(d);
+
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			const __m128i match = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, vc), _mm_cmpeq_epi8(v, vd)));
+			const uint32_t found = uint32_t(_mm_movemask_epi8(match));
+			if (found)
+				return i + LowestBit(found);
+		}
+		return i + UntilAnyScalar(str + i, size - i, a, b, c, d);
+	}
+
+	SCANNER_TARGET_SSE2 void StructuralSSE2(const char* str, std::size_t size, uint64_t& structural, uint64_t& newLines)
+	{
+		if (size < 64) {
+			StructuralScalar(str, size, structural, newLines);
+			return;
+		}
+
+		static const char kStructural[] = { '{', '}', '(', ')', '<', '>', ';', ',', ':', '=', '#', '"', '\'', '/' };
+
+		structural = 0;
+		newLines = 0;
+		for (std::size_t i = 0; i < 64; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			__m128i match = _mm_setzero_si128();
+			for (char c : kStructural)
+				match = _mm_or_si128(match, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+			structural |= uint64_t(uint32_t(_mm_movemask_epi8(match))) << i;
+			newLines |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))))) << i;
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// AVX2 kernels, 32 bytes per step
+	//----------------------------------------------------------------------------------------------
+	SCANNER_TARGET_AVX2 std::size_t WhitespaceAVX2(const char* str, std::size_t size)
+	{
+		const __m256i space = _mm256_set1_epi8(0x20);
+		const __m256i del = _mm256_set1_epi8(0x7F);
+
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+			const __m256i skip = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v), _mm256_cmpeq_epi8(v, del));
+			const uint32_t stop = ~uint32_t(_mm256_movemask_epi8(skip));
+			if (stop)
+				return i + LowestBit(stop);
+		}
+		return i + WhitespaceScalar(str + i, size - i);
+	}
+
+	SCANNER_TARGET_AVX2 inline __m256i InRangeAVX2(__m256i v, char lo, char hi)
+	{
+		const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+		return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(char(hi - lo))), shifted);
+	}
+
+	SCANNER_TARGET_AVX2 std::size_t IdentifierAVX2(const char* str, std::size_t size)
+	{
+		const __m256i lowerCase = _mm256_set1_epi8(0x20);
+		const __m256i underscore = _mm256_set1_epi8('_');
+
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+			const __m256i letter = InRangeAVX2(_mm256_or_si256(v, lowerCase), 'a', 'z');
+			const __m256i match = _mm256_or_si256(_mm256_or_si256(letter, InRangeAVX2(v, '0', '9')), _mm256_cmpeq_epi8(v, underscore));
+			const uint32_t stop = ~uint32_t(_mm256_movemask_epi8(match));
+			if (stop)
+				return i + LowestBit(stop);
+		}
+		return i + IdentifierScalar(str + i, size - i);
+	}
+
+	SCANNER_TARGET_AVX2 std::size_t UntilAnyAVX2(const char* str, std::size_t size, char a, char b, char c, char d)
+	{
+		const __m256i va = _mm256_set1_epi8(a);
+		const __m256i vb = _mm256_set1_epi8(b);
+		const __m256i vc = _mm256_set1_epi8(c);
+		const __m256i vd = _mm256_set1_epi8(d);
+
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+			const __m256i match = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, vc), _mm256_cmpeq_epi8(v, vd)));
+			const uint32_t found = uint32_t(_mm256_movemask_epi8(match));
+			if (found)
+				return i + LowestBit(found);
+		}
+		return i + UntilAnyScalar(str + i, size - i, a, b, c, d);
+	}
+
+	SCANNER_TARGET_AVX2 void StructuralAVX2(const char* str, std::size_t size, uint64_t& structural, uint64_t& newLines)
+	{
+		if (size < 64) {
+			StructuralScalar(str, size, structural, newLines);
+			return;
+		}
+
+		// Nibble lookup: a byte belongs to a class if the class bit is set for both its low and high nibble.
+		// Bits 0-2 are the structural characters of the 0x2_, 0x3_ and 0x7_ rows, bit 3 are the quotes,
+		// bit 4 is the slash and bit 5 the new line.
+		const __m256i lowTable = _mm256_setr_epi8(
+			0, 0, 0x08, 0x01, 0, 0, 0, 0x08, 0x01, 0x01, 0x22, 0x06, 0x03, 0x06, 0x02, 0x10,
+			0, 0, 0x08, 0x01, 0, 0, 0, 0x08, 0x01, 0x01, 0x22, 0x06, 0x03, 0x06, 0x02, 0x10);
+		const __m256i highTable = _mm256_setr_epi8(
+			0x20, 0, 0x19, 0x02, 0, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0,
+			0x20, 0, 0x19, 0x02, 0, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i nibble = _mm256_set1_epi8(0x0F);
+		const __m256i structuralBits = _mm256_set1_epi8(0x1F);
+		const __m256i newLineBit = _mm256_set1_epi8(0x20);
+		const __m256i zero = _mm256_setzero_si256();
+
+		structural = 0;
+		newLines = 0;
+		for (std::size_t i = 0; i < 64; i += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+			const __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(v, nibble));
+			const __m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+			const __m256i classes = _mm256_and_si256(low, high);
+			const __m256i isStructural = _mm256_cmpeq_epi8(_mm256_and_si256(classes, structuralBits), zero);
+			const __m256i isNewLine = _mm256_cmpeq_epi8(_mm256_and_si256(classes, newLineBit), zero);
+			structural |= uint64_t(~uint32_t(_mm256_movemask_epi8(isStructural))) << i;
+			newLines |= uint64_t(~uint32_t(_mm256_movemask_epi8(isNewLine))) << i;
+		}
+	}
+#endif
+
+	//----------------------------------------------------------------------------------------------
+	// Dispatch
+	//----------------------------------------------------------------------------------------------
+	struct ScanKernels
+	{
+		ScanLevel level;
+		std::size_t (*whitespace)(const char*, std::size_t);
+		std::size_t (*identifier)(const char*, std::size_t);
+		std::size_t (*untilAny)(const char*, std::size_t, char, char, char, char);
+		void (*structural)(const char*, std::size_t, uint64_t&, uint64_t&);
+	};
+
+	const ScanKernels g_scalarKernels{ ScanLevel::kScalar, WhitespaceScalar, IdentifierScalar, UntilAnyScalar, StructuralScalar };
+#ifdef SCANNER_X86
+	const ScanKernels g_sse2Kernels{ ScanLevel::kSSE2, WhitespaceSSE2, IdentifierSSE2, UntilAnySSE2, StructuralSSE2 };
+	const ScanKernels g_avx2Kernels{ ScanLevel::kAVX2, WhitespaceAVX2, IdentifierAVX2, UntilAnyAVX2, StructuralAVX2 };
+#endif
+
+	const ScanKernels* SelectKernels(ScanLevel level)
+	{
+		switch (level) {
+#ifdef SCANNER_X86
+		case ScanLevel::kAVX2:
+			return &g_avx2Kernels;
+		case ScanLevel::kSSE2:
+			return &g_sse2Kernels;
+#endif
+		default:
+			return &g_scalarKernels;
+		}
+	}
+
+	const ScanKernels* g_kernels = SelectKernels(DetectScanLevel());
+}
+
+//--------------------------------------------------------------------------------------------------
+ScanLevel DetectScanLevel()
+{
+#if defined(SCANNER_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	return avx2 ? ScanLevel::kAVX2 : sse2 ? ScanLevel::kSSE2 : ScanLevel::kScalar;
+#elif defined(SCANNER_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return ScanLevel::kAVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return ScanLevel::kSSE2;
+	return ScanLevel::kScalar;
+#else
+	return ScanLevel::kScalar;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+ScanLevel GetScanLevel()
+{
+	return g_kernels->level;
+}
+
+//--------------------------------------------------------------------------------------------------
+ScanLevel SetScanLevel(ScanLevel level)
+{
+	if (level > DetectScanLevel())
+		level = DetectScanLevel();
+
+	g_kernels = SelectKernels(level);
+	return g_kernels->level;
+}
+
+//--------------------------------------------------------------------------------------------------
+const char* ScanLevel2String(ScanLevel level)
+{
+	switch (level) {
+	case ScanLevel::kSSE2:
+		return "sse2";
+	case ScanLevel::kAVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ScanWhitespace(const char* str, std::size_t size)
+{
+	return g_kernels->whitespace(str, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ScanIdentifier(const char* str, std::size_t size)
+{
+	return g_kernels->identifier(str, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ScanUntilAny(const char* str, std::size_t size, char a, char b, char c, char d)
+{
+	return g_kernels->untilAny(str, size, a, b, c, d);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ScanStructural(const char* str, std::size_t size, uint64_t& structural, uint64_t& newLines)
+{
+	g_kernels->structural(str, size, structural, newLines);
+}
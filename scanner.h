@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/// Instruction set used by the scanning kernels
+enum class ScanLevel
+{
+	kScalar,
+	kSSE2,
+	kAVX2
+};
+
+/// Returns the best instruction set supported by the running CPU
+ScanLevel DetectScanLevel();
+
+/// Returns the instruction set the scanning kernels currently dispatch to
+ScanLevel GetScanLevel();
+
+/// Forces the scanning kernels to the given instruction set (clamped to what the CPU supports).
+/// Must be called before any parsing thread is started.
+ScanLevel SetScanLevel(ScanLevel level);
+
+const char* ScanLevel2String(ScanLevel level);
+
+/// Returns the index of the lowest set bit, mask must not be zero
+inline unsigned LowestBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, uint32_t(mask)))
+		return index;
+	_BitScanForward(&index, uint32_t(mask >> 32));
+	return index + 32;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+/// Returns the index of the highest set bit, mask must not be zero
+inline unsigned HighestBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, mask);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanReverse(&index, uint32_t(mask >> 32)))
+		return index + 32;
+	_BitScanReverse(&index, uint32_t(mask));
+	return index;
+#else
+	return 63 - __builtin_clzll(mask);
+#endif
+}
+
+/// Returns the number of set bits
+inline std::size_t CountBits(uint64_t mask)
+{
+	mask = mask - ((mask >> 1) & 0x5555555555555555ull);
+	mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+	return std::size_t((((mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0Full) * 0x0101010101010101ull) >> 56);
+}
+
+/// Returns the number of leading whitespace and control characters (the bytes 0x00-0x20 and 0x7F).
+std::size_t ScanWhitespace(const char* str, std::size_t size);
+
+/// Returns the number of leading identifier characters ([A-Za-z0-9_]).
+std::size_t ScanIdentifier(const char* str, std::size_t size);
+
+/// Returns the offset of the first byte that equals a, b, c or d, or size if there is none.
+std::size_t ScanUntilAny(const char* str, std::size_t size, char a, char b, char c, char d);
+
+/// Classifies up to 64 bytes. Bit n of structural is set if byte n is one of { } ( ) < > ; , : = #,
+/// a quote or a slash, bit n of newLines is set if byte n is a new line.
+void ScanStructural(const char* str, std::size_t size, uint64_t& structural, uint64_t& newLines);
@@ -0,0 +1,93 @@
+#include "structural_index.h"
+#include "scanner.h"
+
+//--------------------------------------------------------------------------------------------------
+StructuralIndex::StructuralIndex() :
+	size_(0),
+	lineCounts_(1, 0)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+void StructuralIndex::Build(const char* input, std::size_t size)
+{
+	const std::size_t blocks = (size + 63) / 64;
+
+	size_ = size;
+	structural_.resize(blocks);
+	newLines_.resize(blocks);
+	lineCounts_.resize(blocks + 1);
+
+	uint32_t lines = 0;
+	for (std::size_t block = 0; block < blocks; ++block)
+	{
+		const std::size_t offset = block * 64;
+		const std::size_t length = size - offset < 64 ? size - offset : 64;
+		ScanStructural(input + offset, length, structural_[block], newLines_[block]);
+
+		lineCounts_[block] = lines;
+		lines += uint32_t(CountBits(newLines_[block]));
+	}
+	lineCounts_[blocks] = lines;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StructuralIndex::NextBit(const std::vector<uint64_t>& bitmap, std::size_t offset) const
+{
+	if (offset >= size_)
+		return size_;
+
+	std::size_t block = offset / 64;
+	uint64_t bits = bitmap[block] & (~uint64_t(0) << (offset % 64));
+	while (bits == 0)
+	{
+		if (++block == bitmap.size())
+			return size_;
+		bits = bitmap[block];
+	}
+
+	return block * 64 + LowestBit(bits);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StructuralIndex::NextStructural(std::size_t offset) const
+{
+	return NextBit(structural_, offset);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StructuralIndex::NextNewLine(std::size_t offset) const
+{
+	return NextBit(newLines_, offset);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StructuralIndex::LineAt(std::size_t offset) const
+{
+	if (offset >= size_)
+		return 1 + lineCounts_.back();
+
+	const std::size_t block = offset / 64;
+	const uint64_t before = newLines_[block] & ((uint64_t(1) << (offset % 64)) - 1);
+	return 1 + lineCounts_[block] + CountBits(before);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StructuralIndex::LineStart(std::size_t offset) const
+{
+	if (offset > size_)
+		offset = size_;
+
+	// Search backwards for the new line in front of the offset
+	std::size_t block = offset / 64;
+	uint64_t bits = block < newLines_.size() ? newLines_[block] & ((uint64_t(1) << (offset % 64)) - 1) : 0;
+	while (bits == 0)
+	{
+		if (block == 0)
+			return 0;
+		bits = newLines_[--block];
+	}
+
+	return block * 64 + HighestBit(bits) + 1;
+}
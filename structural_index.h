@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/// Bitmap index of the structural characters and new lines of an input buffer.
+/// Every 64 bytes of input are described by one word per bitmap, which lets the tokenizer jump
+/// from one structural character to the next and compute line numbers with a popcount.
+class StructuralIndex
+{
+public:
+	StructuralIndex();
+
+	/// Builds the index for the given input, reusing the storage of the previous input
+	void Build(const char* input, std::size_t size);
+
+	/// Returns the offset of the first structural character at or after offset, or the input size if there is none
+	std::size_t NextStructural(std::size_t offset) const;
+
+	/// Returns the offset of the first new line at or after offset, or the input size if there is none
+	std::size_t NextNewLine(std::size_t offset) const;
+
+	/// Returns the line (starting at 1) the given offset is on
+	std::size_t LineAt(std::size_t offset) const;
+
+	/// Returns the offset of the first character of the line the given offset is on
+	std::size_t LineStart(std::size_t offset) const;
+
+private:
+	std::size_t NextBit(const std::vector<uint64_t>& bitmap, std::size_t offset) const;
+
+	/// The length of the indexed input
+	std::size_t size_;
+
+	/// Structural characters ({ } ( ) < > ; , : = #, quotes and slashes), one word per 64 bytes
+	std::vector<uint64_t> structural_;
+
+	/// New lines, one word per 64 bytes
+	std::vector<uint64_t> newLines_;
+
+	/// The number of new lines in front of each block of 64 bytes
+	std::vector<uint32_t> lineCounts_;
+};
@@ -4,7 +4,9 @@
 #include <string>
 #include <array>
 
-enum class TokenType
+#include "keywords.h"
+
+enum class TokenType : uint8_t
 {
 	kNone,
 	kSymbol,
@@ -13,7 +15,7 @@ enum class TokenType
 	kMacro
 };
 
-enum class ConstType
+enum class ConstType : uint8_t
 {
 	kString,
 	kBoolean,
@@ -21,16 +23,38 @@ enum class ConstType
 	kInt32,
 	kUInt64,
 	kInt64,
-	kReal
+	kReal,
+
+	/// A number that is not decoded, e.g. because of a user-defined or compiler specific suffix like 10i64 or 1.0_km
+	kUnknown
 };
 
+/// A token refers to its text in the input, use Tokenizer::GetText to get the text
+/// and Tokenizer::GetConstValue or Tokenizer::GetString to get the value of a constant.
 struct Token
 {
 	TokenType tokenType;
-	std::size_t startPos;
-	std::size_t startLine;
-	std::string_view token;
 
+	/// The keyword an identifier spells, Keyword::kNone for everything else
+	Keyword keyword;
+
+	ConstType constType;
+
+	/// Set for string constants without closing element
+	bool unterminated;
+
+	/// Offset of the token in the input
+	uint32_t startPos;
+
+	/// Length of the token in the input, quotes of strings included
+	uint32_t length;
+};
+
+static_assert(sizeof(Token) == 12, "Tokens are kept small to copy them around freely");
+
+/// The value of a boolean or number constant
+struct ConstValue
+{
 	ConstType constType;
 	union
 	{
@@ -41,5 +65,4 @@ struct Token
 		int64_t int64Const;
 		double realConst;
 	};
-	std::string stringConst;
 };
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "token_stream.h"
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+TokenStream::TokenStream()
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+void TokenStream::Clear()
+{
+	kinds_.clear();
+	offsets_.clear();
+	lengths_.clear();
+	keywords_.clear();
+	comments_.clear();
+	commentStarts_.clear();
+	commentLengths_.clear();
+	commentEnds_.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+void TokenStream::Append(const Token& token, uint32_t comment)
+{
+	uint8_t kind = uint8_t(token.tokenType);
+	if (token.tokenType == TokenType::kConst)
+		kind |= uint8_t(token.constType) << kConstTypeShift;
+	if (token.unterminated)
+		kind |= kUnterminated;
+
+	kinds_.push_back(kind);
+	offsets_.push_back(token.startPos);
+	lengths_.push_back(token.length);
+	keywords_.push_back(token.keyword);
+	comments_.push_back(comment);
+}
+
+//--------------------------------------------------------------------------------------------------
+uint32_t TokenStream::AddComment(std::size_t offset, std::size_t length, std::size_t endPos)
+{
+	commentStarts_.push_back(uint32_t(offset));
+	commentLengths_.push_back(uint32_t(length));
+	commentEnds_.push_back(uint32_t(endPos));
+	return uint32_t(commentStarts_.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t TokenStream::LowerBound(std::size_t offset) const
+{
+	return std::lower_bound(offsets_.cbegin(), offsets_.cend(), offset,
+		[](uint32_t tokenOffset, std::size_t value) { return tokenOffset < value; }) - offsets_.cbegin();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "token.h"
+
+/// The tokens of a whole input stored column by column.
+/// Tokens are addressed by their index, so going back to an earlier token is a matter of resetting an index.
+/// The storage is kept when the stream is cleared, which lets a worker reuse one stream for every file it parses.
+class TokenStream
+{
+public:
+	TokenStream();
+
+	// Do not allow copy
+	TokenStream(const TokenStream& other) = delete;
+
+	/// Removes all tokens while keeping the storage
+	void Clear();
+
+	/// Appends a token, comment is the id returned by AddComment for the comment block in front of the token or 0 if there is none
+	void Append(const Token& token, uint32_t comment);
+
+	/// Stores the span of the comment block in front of the next token and returns its id
+	uint32_t AddComment(std::size_t offset, std::size_t length, std::size_t endPos);
+
+	/// Returns the number of tokens in the stream
+	std::size_t Size() const { return offsets_.size(); }
+
+	/// Returns the index of the first token that starts at or after offset
+	std::size_t LowerBound(std::size_t offset) const;
+
+	TokenType GetType(std::size_t index) const { return TokenType(kinds_[index] & kTypeMask); }
+	ConstType GetConstType(std::size_t index) const { return ConstType((kinds_[index] >> kConstTypeShift) & kConstTypeMask); }
+	bool IsUnterminated(std::size_t index) const { return (kinds_[index] & kUnterminated) != 0; }
+	std::size_t GetOffset(std::size_t index) const { return offsets_[index]; }
+	std::size_t GetLength(std::size_t index) const { return lengths_[index]; }
+	std::size_t GetEnd(std::size_t index) const { return std::size_t(offsets_[index]) + lengths_[index]; }
+	Keyword GetKeyword(std::size_t index) const { return keywords_[index]; }
+
+	/// Returns the id of the comment block in front of the token, or 0 if there is none
+	uint32_t GetComment(std::size_t index) const { return comments_[index]; }
+	std::size_t GetCommentStart(uint32_t comment) const { return commentStarts_[comment - 1]; }
+	std::size_t GetCommentLength(uint32_t comment) const { return commentLengths_[comment - 1]; }
+	std::size_t GetCommentEnd(uint32_t comment) const { return commentEnds_[comment - 1]; }
+
+	/// Returns true if an input of the given size can be stored
+	static bool CanStore(std::size_t size) { return size < UINT32_MAX; }
+
+private:
+	static const uint8_t kTypeMask = 0x07;
+	static const uint8_t kConstTypeShift = 3;
+	static const uint8_t kConstTypeMask = 0x07;
+	static const uint8_t kUnterminated = 0x80;
+
+	/// TokenType in the low bits, ConstType above it and a flag for strings without a closing quote
+	std::vector<uint8_t> kinds_;
+	std::vector<uint32_t> offsets_;
+	std::vector<uint32_t> lengths_;
+	std::vector<Keyword> keywords_;
+	std::vector<uint32_t> comments_;
+
+	/// Spans of the comment blocks
+	std::vector<uint32_t> commentStarts_;
+	std::vector<uint32_t> commentLengths_;
+	std::vector<uint32_t> commentEnds_;
+};
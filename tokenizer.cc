@@ -1,14 +1,164 @@
 #include "tokenizer.h"
 #include "token.h"
+#include "scanner.h"
+#include "token_stream.h"
 #include <string>
 #include <cctype>
 #include <stdexcept>
 #include <vector>
 #include <sstream>
 #include <cstdarg>
+#include <charconv>
 
 namespace {
 	static const char EndOfFileChar = std::char_traits<char>::to_char_type(std::char_traits<char>::eof());
+
+	/// One bit for every pair of characters that starts a symbol of two or more characters
+	struct OperatorTable
+	{
+		uint64_t bits[256 * 256 / 64];
+
+		constexpr OperatorTable() : bits()
+		{
+			const char* const operators[] = {
+				"<<", "->", ">>", "!=", "<=", ">=", "++", "--", "+=", "-=", "*=", "/=",
+				"^=", "|=", "&=", "~=", "%=", "&&", "||", "==", "::", ".."
+			};
+			for (const char* op : operators)
+			{
+				const unsigned index = unsigned(uint8_t(op[0])) << 8 | uint8_t(op[1]);
+				bits[index / 64] |= uint64_t(1) << (index % 64);
+			}
+		}
+
+		constexpr bool Contains(char c, char d) const
+		{
+			const unsigned index = unsigned(uint8_t(c)) << 8 | uint8_t(d);
+			return (bits[index / 64] >> (index % 64)) & 1;
+		}
+	};
+
+	constexpr OperatorTable kOperators;
+	static_assert(kOperators.Contains('-', '>') && !kOperators.Contains('>', '-'), "Operator table is broken");
+
+	/// Returns true if every character of the suffix is one of the allowed characters
+	bool IsSuffix(const std::string_view& suffix, const std::string_view& allowed)
+	{
+		return suffix.length() <= 3 && suffix.find_first_not_of(allowed) == std::string_view::npos;
+	}
+
+	/// Decodes the value of a number literal with an optional sign, base prefix, digit separators and suffix.
+	/// Integers get the smallest of kInt32 and kInt64 (negative) or kUInt32 and kUInt64 that holds the value.
+	/// Returns false if the literal is malformed or does not fit in 64 bits.
+	bool DecodeNumber(std::string_view text, ConstValue& value)
+	{
+		const bool isNegated = text[0] == '-';
+		if (text[0] == '-' || text[0] == '+')
+			text.remove_prefix(1);
+
+		int base = 10;
+		if (text.length() > 1 && text[0] == '0')
+		{
+			if (text[1] == 'x' || text[1] == 'X')
+				base = 16;
+			else if (text[1] == 'b' || text[1] == 'B')
+				base = 2;
+
+			if (base != 10)
+				text.remove_prefix(2);
+		}
+
+		// Gather the digits without separators, whatever follows them is the suffix
+		char digits[128];
+		std::size_t length = 0;
+		bool isFloat = false;
+		bool isExponent = false;
+		std::size_t i = 0;
+		for (; i < text.length(); ++i)
+		{
+			const char c = text[i];
+			const std::char_traits<char>::int_type intc = std::char_traits<char>::to_int_type(c);
+			if (c == '\'')
+				continue;
+
+			if (isExponent)
+			{
+				// The exponent is decimal, even for hexadecimal floats
+				if (!std::isdigit(intc) && !((c == '+' || c == '-') && (text[i - 1] == 'e' || text[i - 1] == 'E' || text[i - 1] == 'p' || text[i - 1] == 'P')))
+					break;
+			}
+			else if (c == '.')
+				isFloat = true;
+			else if ((base == 10 && (c == 'e' || c == 'E')) || (base == 16 && (c == 'p' || c == 'P')))
+				isFloat = isExponent = true;
+			else if (!(base == 16 ? std::isxdigit(intc) : std::isdigit(intc)))
+				break;
+
+			if (length == sizeof(digits))
+				return false;
+			digits[length++] = c;
+		}
+
+		const std::string_view suffix = text.substr(i);
+		if (isFloat)
+		{
+			if (base == 2 || !IsSuffix(suffix, "fFlL"))
+				return false;
+
+			double real;
+			const auto result = std::from_chars(digits, digits + length, real, base == 16 ? std::chars_format::hex : std::chars_format::general);
+			if (result.ec != std::errc() || result.ptr != digits + length)
+				return false;
+
+			value.realConst = isNegated ? -real : real;
+			value.constType = ConstType::kReal;
+			return true;
+		}
+
+		if (!IsSuffix(suffix, "uUlLzZ"))
+			return false;
+
+		// A leading zero makes a decimal literal octal
+		const char* first = digits;
+		if (base == 10 && length > 1 && digits[0] == '0')
+		{
+			base = 8;
+			++first;
+		}
+
+		uint64_t integer;
+		const auto result = std::from_chars(first, digits + length, integer, base);
+		if (result.ec != std::errc() || result.ptr != digits + length)
+			return false;
+
+		if (isNegated)
+		{
+			if (integer <= uint64_t(INT32_MAX) + 1)
+			{
+				value.int32Const = int32_t(0 - integer);
+				value.constType = ConstType::kInt32;
+			}
+			else if (integer <= uint64_t(INT64_MAX) + 1)
+			{
+				value.int64Const = int64_t(0 - integer);
+				value.constType = ConstType::kInt64;
+			}
+			else
+				return false;
+		}
+		else if (integer <= UINT32_MAX)
+		{
+			value.uint32Const = uint32_t(integer);
+			value.constType = ConstType::kUInt32;
+		}
+		else
+		{
+			value.uint64Const = integer;
+			value.constType = ConstType::kUInt64;
+		}
+
+		return true;
+	}
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -16,10 +166,24 @@ Tokenizer::Tokenizer() :
 	input_(nullptr),
 	inputLength_(0),
 	cursorPos_(0),
-	cursorLine_(0),
+	comment_(),
+	lastComment_(),
 	error_(),
-	m_macrosEnabled(true)
+	m_macrosEnabled(true),
+	m_sharedMacros(nullptr),
+	tokenCacheNext_(0),
+	stream_(nullptr),
+	streamIndex_(0),
+	pretokenizing_(false),
+	macrosParsed_(0),
+	macroTargetPos_(std::string_view::npos),
+	tokensLexed_(0),
+	tokenCacheHits_(0),
+	bytesLexed_(0),
+	bytesRelexed_(0),
+	lexedEnd_(0)
 {
+	InvalidateTokenCache();
 
 }
 
@@ -35,7 +199,86 @@ void Tokenizer::Reset(const char* input, size_t size)
 	input_ = input;
 	inputLength_ = size;
 	cursorPos_ = 0;
-	cursorLine_ = 1;
+	macroTargetPos_ = std::string_view::npos;
+	index_.Build(input, size);
+
+	// The comments are spans of the previous input
+	comment_ = Comment();
+	lastComment_ = Comment();
+
+	InvalidateTokenCache();
+	tokensLexed_ = 0;
+	tokenCacheHits_ = 0;
+	bytesLexed_ = 0;
+	bytesRelexed_ = 0;
+	lexedEnd_ = 0;
+
+	if (stream_ != nullptr)
+		Pretokenize();
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SetTokenStream(TokenStream* stream)
+{
+	stream_ = stream;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::Pretokenize()
+{
+	stream_->Clear();
+	streamIndex_ = 0;
+
+	// Inputs the stream cannot address are lexed as tokens are requested
+	if (!TokenStream::CanStore(inputLength_))
+		return;
+
+	const Comment comment = comment_;
+	const Comment lastComment = lastComment_;
+	const bool macrosEnabled = m_macrosEnabled;
+
+	// Macros are expanded when the tokens are read, they can be added after the reset
+	m_macrosEnabled = false;
+	pretokenizing_ = true;
+
+	Token token;
+	while (LexToken<LexMode::kDefault>(token))
+	{
+		uint32_t commentId = 0;
+		if (comment_.length != 0)
+			commentId = stream_->AddComment(comment_.offset, comment_.length, comment_.endPos);
+
+		stream_->Append(token, commentId);
+	}
+
+	m_macrosEnabled = macrosEnabled;
+	pretokenizing_ = false;
+	comment_ = comment;
+	lastComment_ = lastComment;
+	tokensLexed_ = stream_->Size();
+	bytesLexed_ = cursorPos_;
+	lexedEnd_ = cursorPos_;
+	cursorPos_ = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::CountLexed(std::size_t startPos)
+{
+	if (cursorPos_ <= startPos)
+		return;
+
+	bytesLexed_ += cursorPos_ - startPos;
+	if (startPos < lexedEnd_)
+		bytesRelexed_ += (cursorPos_ < lexedEnd_ ? cursorPos_ : lexedEnd_) - startPos;
+	if (cursorPos_ > lexedEnd_)
+		lexedEnd_ = cursorPos_;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::InvalidateTokenCache()
+{
+	for (auto& entry : tokenCache_)
+		entry.startPos = std::string_view::npos;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -43,7 +286,6 @@ char Tokenizer::GetChar(bool setPrevious)
 {
 	if (setPrevious) {
 		prevCursorPos_ = cursorPos_;
-		prevCursorLine_ = cursorLine_;
 	}
 
 
@@ -60,10 +302,6 @@ char Tokenizer::GetChar(bool setPrevious)
 		return GetChar(false);
 	}
 
-	// New line moves the cursor to the new line
-	if(c == '\n')
-		cursorLine_++;
-
 	cursorPos_++;
 	return c;
 }
@@ -71,7 +309,6 @@ char Tokenizer::GetChar(bool setPrevious)
 //--------------------------------------------------------------------------------------------------
 void Tokenizer::UngetChar()
 {
-	cursorLine_ = prevCursorLine_;
 	cursorPos_ = prevCursorPos_;
 }
 
@@ -86,27 +323,18 @@ char Tokenizer::peek() const
 //--------------------------------------------------------------------------------------------------
 char Tokenizer::GetLeadingChar()
 {
-	if (!comment_.text.empty())
+	if (comment_.length != 0)
 		lastComment_ = comment_;
 
-	comment_.text = "";
-	comment_.startLine = cursorLine_;
-	comment_.endLine = cursorLine_;
+	comment_.offset = cursorPos_;
+	comment_.length = 0;
+	comment_.endPos = cursorPos_;
 
 	char c;
-	for(c = GetChar(); c != EndOfFileChar; c = GetChar())
+	for(SkipWhitespace(), c = GetChar(); c != EndOfFileChar; SkipWhitespace(), c = GetChar())
 	{
 		// If this is a whitespace character skip it
 		std::char_traits<char>::int_type intc = std::char_traits<char>::to_int_type(c);
-
-		// In case of a new line
-		if (c == '\n')
-		{
-			if (!comment_.text.empty())
-				comment_.text += "\n";
-			continue;
-		}
-
 		if(std::isspace(intc) || std::iscntrl(intc))
 			continue;
 
@@ -114,40 +342,26 @@ char Tokenizer::GetLeadingChar()
 		char next = peek();
 		if(c == '/' && next == '/')
 		{
-			std::vector<std::string> lines;
-
-			size_t indentationLastLine = 0;
+			// Only the span is recorded, GetCommentText builds the text from it
+			const size_t startPos = prevCursorPos_;
+			size_t endPos = startPos;
+			size_t lineCount = 0;
+			bool isEmpty = true;
 			while (!is_eof() && c == '/' && next == '/')
 			{
 				// Search for the end of the line
-				std::string line;
+				const size_t lineStart = cursorPos_;
 				for (c = GetChar();
 					c != EndOfFileChar && c != '\n';
 					c = GetChar())
 				{
-					line += c;
+					// Skip everything up to the next character that needs special handling at once
+					cursorPos_ += ScanUntilAny(input_ + cursorPos_, inputLength_ - cursorPos_, '\n', '\r', EndOfFileChar, '\n');
 				}
-				
-				// Store the line
-				size_t lastSlashIndex = line.find_first_not_of("/");
-				if (lastSlashIndex == std::string::npos)
-					line = "";
-				else
-					line = line.substr(lastSlashIndex);
 
-				size_t firstCharIndex = line.find_first_not_of(" \t");
-				if (firstCharIndex == std::string::npos)
-					line = "";
-				else
-					line = line.substr(firstCharIndex);
-
-				if (firstCharIndex > indentationLastLine && !lines.empty())
-					lines.back() += std::string(" ") + line;
-				else
-				{
-					lines.emplace_back(std::move(line));
-					indentationLastLine = firstCharIndex;
-				}
+				endPos = c == EndOfFileChar ? inputLength_ : prevCursorPos_;
+				if (lineCount++ == 0)
+					isEmpty = IsEmptyCommentLine(input_ + lineStart, endPos - lineStart);
 
 				// Check the next line
 				while (!is_eof() && std::isspace(c = GetChar()));
@@ -160,17 +374,10 @@ char Tokenizer::GetLeadingChar()
 			if (!is_eof())
 				UngetChar();
 
-			// Build comment string
-			std::stringstream ss;
-			for (size_t i = 0; i < lines.size(); ++i)
-			{
-				if (i > 0)
-					ss << "\n";
-				ss << lines[i];
-			}
-
-			comment_.text = ss.str();
-			comment_.endLine = cursorLine_;
+			// A single line without text is no comment
+			comment_.offset = startPos;
+			comment_.length = lineCount == 1 && isEmpty ? 0 : endPos - startPos;
+			comment_.endPos = cursorPos_;
 
 			// Go to the next
 			continue;
@@ -179,23 +386,27 @@ char Tokenizer::GetLeadingChar()
 		// If this is a block comment
 		if(c == '/' && next == '*')
 		{
-			// Search for the end of the block comment
-			std::vector<std::string> lines;
-			std::string line;
+			// Search for the end of the block comment, only lines ended by a new line can contribute text
+			const size_t startPos = prevCursorPos_;
+			bool hasText = false;
+			bool lineHasText = false;
 			for (c = GetChar(), next = peek();
 				c != EndOfFileChar && (c != '*' || next != '/');
 				c = GetChar(), next = peek())
 			{
 				if (c == '\n')
 				{
-					if (!lines.empty() || !line.empty())
-						lines.emplace_back(line);
-					line.clear();
+					hasText = hasText || lineHasText;
+					lineHasText = false;
 				}
 				else
 				{
-					if (!line.empty() || !(std::isspace(c) || c == '*'))
-						line += c;
+					if (!lineHasText && !(std::isspace(c) || c == '*'))
+						lineHasText = true;
+
+					// Once the line has text, everything up to the next character that needs special handling belongs to it
+					if (lineHasText)
+						cursorPos_ += ScanUntilAny(input_ + cursorPos_, inputLength_ - cursorPos_, '\n', '\r', '*', EndOfFileChar);
 				}
 			}
 
@@ -203,26 +414,16 @@ char Tokenizer::GetLeadingChar()
 			if(c != EndOfFileChar)
 				GetChar();
 
+			const size_t endPos = cursorPos_ < inputLength_ ? cursorPos_ : inputLength_;
+
 			// Skip past new lines and spaces
 			while (!is_eof() && std::isspace(c = GetChar()));
 			if (!is_eof())
 				UngetChar();
 
-			// Remove empty lines from the back
-			while (!lines.empty() && lines.back().empty())
-				lines.pop_back();
-
-			// Build comment string
-			std::stringstream ss;
-			for (size_t i = 0; i < lines.size(); ++i)
-			{
-				if (i > 0)
-					ss << "\n";
-				ss << lines[i]; 
-			}
-
-			comment_.text = ss.str();
-			comment_.endLine = cursorLine_;
+			comment_.offset = startPos;
+			comment_.length = hasText ? endPos - startPos : 0;
+			comment_.endPos = cursorPos_;
 
 			// Move to the next character
 			continue;
@@ -234,9 +435,530 @@ char Tokenizer::GetLeadingChar()
 	return c;
 }
 
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::IsEmptyCommentLine(const char* str, size_t length)
+{
+	// GetCommentText drops carriage returns, the slashes in front of the text and the indentation
+	size_t i = 0;
+	while (i < length && (str[i] == '/' || str[i] == '\r'))
+		++i;
+	while (i < length && (str[i] == ' ' || str[i] == '\t' || str[i] == '\r'))
+		++i;
+	return i == length;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::GetCommentText(const Comment& comment, std::string& buffer) const
+{
+	buffer.clear();
+	if (comment.length == 0)
+		return;
+
+	const char* str = input_ + comment.offset;
+	const char* end = str + comment.length;
+
+	// Consecutive line comments, lines that are indented more than the line before continue it
+	if (str[1] == '/')
+	{
+		std::string line;
+		size_t indentationLastLine = 0;
+		bool first = true;
+		while (str < end)
+		{
+			// Take everything after the first slash up to the end of the line
+			line.clear();
+			for (++str; str < end && *str != '\n'; ++str)
+			{
+				if (*str != '\r')
+					line += *str;
+			}
+
+			size_t lastSlashIndex = line.find_first_not_of("/");
+			if (lastSlashIndex == std::string::npos)
+				line.clear();
+			else
+				line.erase(0, lastSlashIndex);
+
+			size_t firstCharIndex = line.find_first_not_of(" \t");
+			if (firstCharIndex == std::string::npos)
+				line.clear();
+			else
+				line.erase(0, firstCharIndex);
+
+			if (firstCharIndex > indentationLastLine && !first)
+				buffer.append(" ").append(line);
+			else
+			{
+				if (!first)
+					buffer += '\n';
+				buffer += line;
+				indentationLastLine = firstCharIndex;
+			}
+			first = false;
+
+			// Move to the next comment line
+			while (str < end && std::isspace(std::char_traits<char>::to_int_type(*str)))
+				++str;
+		}
+		return;
+	}
+
+	// Block comment, the text starts at the first character that is neither a space nor an asterisk
+	const bool isTerminated = comment.length >= 3 && end[-2] == '*' && end[-1] == '/';
+	if (isTerminated)
+		end -= 2;
+
+	std::string line;
+	bool hasLines = false;
+	size_t textLength = 0;
+	for (++str; str < end; ++str)
+	{
+		const char c = *str;
+		if (c == '\r')
+			continue;
+
+		if (c == '\n')
+		{
+			if (hasLines || !line.empty())
+			{
+				if (hasLines)
+					buffer += '\n';
+				buffer += line;
+				hasLines = true;
+
+				// Empty lines at the end are dropped
+				if (!line.empty())
+					textLength = buffer.length();
+			}
+			line.clear();
+		}
+		else if (!line.empty() || !(std::isspace(std::char_traits<char>::to_int_type(c)) || c == '*'))
+			line += c;
+	}
+
+	buffer.resize(textLength);
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SkipWhitespace()
+{
+	if (is_eof())
+		return;
+
+	// Most tokens are not preceded by white space at all
+	const unsigned char first = input_[cursorPos_];
+	if (first > 0x20 && first != 0x7F)
+		return;
+
+	size_t length = ScanWhitespace(input_ + cursorPos_, inputLength_ - cursorPos_);
+
+	// Leave carriage returns in front of the next character to GetChar so the previous cursor position stays the same
+	while (length > 0 && input_[cursorPos_ + length - 1] == '\r')
+		--length;
+
+	cursorPos_ += length;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::SkipStatement()
+{
+	const size_t end = FindStatementEnd();
+	SkipTo(end == std::string_view::npos ? inputLength_ : end);
+	return end != std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::FindStatementEnd() const
+{
+	int32_t scopeDepth = 0;
+	for (size_t pos = index_.NextStructural(cursorPos_); pos < inputLength_; pos = index_.NextStructural(pos))
+	{
+		switch (input_[pos])
+		{
+		case '"':
+		case '\'':
+			pos = SkipLiteral(pos);
+			break;
+		case '/':
+			pos = SkipComment(pos);
+			break;
+		case ';':
+			if (scopeDepth == 0)
+				return pos + 1;
+			++pos;
+			break;
+		case '{':
+			++scopeDepth;
+			++pos;
+			break;
+		case '}':
+			if (--scopeDepth == 0)
+				return pos + 1;
+			++pos;
+			break;
+		default:
+			++pos;
+			break;
+		}
+	}
+
+	return std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::FindMacroUse(size_t begin, size_t end, bool nested) const
+{
+	const bool hasSharedMacros = m_sharedMacros != nullptr && !m_sharedMacros->Empty();
+	if (!hasSharedMacros && m_macros.Empty())
+		return std::string_view::npos;
+
+	int32_t depth = 0;
+	for (size_t pos = begin; pos < end;)
+	{
+		const char c = input_[pos];
+		if (std::isalnum(std::char_traits<char>::to_int_type(c)) || c == '_')
+		{
+			// Numbers are skipped like identifiers, only names starting like a macro are looked up
+			const size_t length = ScanIdentifier(input_ + pos, end - pos);
+			const bool mayBeMacro = (hasSharedMacros && m_sharedMacros->MayStartWith(c)) || m_macros.MayStartWith(c);
+			if (mayBeMacro && (nested || depth == 0) && !std::isdigit(std::char_traits<char>::to_int_type(c)) &&
+				IsMacro(std::string_view(input_ + pos, length)))
+				return pos;
+			pos += length;
+			continue;
+		}
+
+		switch (c)
+		{
+		case '"':
+		case '\'':
+			pos = SkipLiteral(pos);
+			break;
+		case '/':
+			pos = SkipComment(pos);
+			break;
+		case '#':
+			// Macros in directives are not annotations
+			pos = IsLineStart(pos) ? FindLineEnd(pos, true) : pos + 1;
+			break;
+		case '{':
+			++depth;
+			++pos;
+			break;
+		case '}':
+			--depth;
+			++pos;
+			break;
+		default:
+			++pos;
+			break;
+		}
+	}
+
+	return std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SkipTo(size_t pos)
+{
+	// Comments in front of the last read token would have become the last comment with the next token
+	if (comment_.length != 0)
+		lastComment_ = comment_;
+	comment_.length = 0;
+
+	SetCursor(pos);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::IsLineStart(size_t pos) const
+{
+	size_t lineStart = index_.LineStart(pos);
+	while (lineStart < pos && (input_[lineStart] == ' ' || input_[lineStart] == '\t' || input_[lineStart] == '\r'))
+		++lineStart;
+	return lineStart == pos;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::FindExpressionEnd() const
+{
+	int32_t depth = 0;
+	for (size_t pos = index_.NextStructural(cursorPos_); pos < inputLength_; pos = index_.NextStructural(pos))
+	{
+		switch (input_[pos])
+		{
+		case '"':
+		case '\'':
+			pos = SkipLiteral(pos);
+			break;
+		case '/':
+			pos = SkipComment(pos);
+			break;
+		case '(':
+		case '{':
+			++depth;
+			++pos;
+			break;
+		case ')':
+			if (depth == 0)
+				return pos;
+			--depth;
+			++pos;
+			break;
+		case '}':
+			// A brace that was not opened ends the declaration the expression is in
+			if (depth == 0)
+				return pos;
+			--depth;
+			++pos;
+			break;
+		case ',':
+		case ';':
+			if (depth == 0)
+				return pos;
+			++pos;
+			break;
+		default:
+			++pos;
+			break;
+		}
+	}
+
+	return inputLength_;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::SkipConditionalBranch()
+{
+	int32_t depth = 0;
+	for (size_t pos = index_.NextStructural(cursorPos_); pos < inputLength_; pos = index_.NextStructural(pos))
+	{
+		switch (input_[pos])
+		{
+		case '"':
+		case '\'':
+			pos = SkipLiteral(pos);
+			break;
+		case '/':
+			pos = SkipComment(pos);
+			break;
+		case '#':
+		{
+			size_t name = pos + 1;
+			while (name < inputLength_ && (input_[name] == ' ' || input_[name] == '\t'))
+				++name;
+			const size_t length = ScanIdentifier(input_ + name, inputLength_ - name);
+			const std::string_view directive(input_ + name, length);
+
+			// Only a # at the start of a line begins a directive
+			if (!IsLineStart(pos))
+			{
+				++pos;
+				break;
+			}
+
+			if (directive == "if" || directive == "ifdef" || directive == "ifndef")
+				++depth;
+			else if (directive == "endif" && depth > 0)
+				--depth;
+			else if ((directive == "endif" || directive == "else" || directive == "elif") && depth == 0)
+			{
+				SkipTo(pos);
+				return true;
+			}
+
+			pos = name + length;
+			break;
+		}
+		default:
+			++pos;
+			break;
+		}
+	}
+
+	SkipTo(inputLength_);
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SkipLine(bool continuation)
+{
+	SetCursor(FindLineEnd(cursorPos_, continuation));
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::FindLineEnd(size_t pos, bool continuation) const
+{
+	const size_t start = pos;
+	for (;;)
+	{
+		pos = index_.NextNewLine(pos);
+		if (pos >= inputLength_)
+			break;
+
+		// Find the last character of the line
+		size_t last = pos;
+		while (last > start && input_[last - 1] == '\r')
+			--last;
+
+		++pos;
+		if (!continuation || last == start || input_[last - 1] != '\\')
+			break;
+	}
+
+	return pos < inputLength_ ? pos : inputLength_;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::GetColumn(size_t pos) const
+{
+	if (pos > inputLength_)
+		pos = inputLength_;
+
+	// Columns count characters, carriage returns are not part of the line
+	size_t column = 1;
+	for (size_t i = index_.LineStart(pos); i < pos; ++i)
+	{
+		if (input_[i] != '\r')
+			++column;
+	}
+	return column;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SetCursor(size_t pos)
+{
+	cursorPos_ = pos;
+	prevCursorPos_ = cursorPos_;
+}
+
+//--------------------------------------------------------------------------------------------------
+Tokenizer::CursorState Tokenizer::GetCursorState() const
+{
+	return CursorState{ cursorPos_, prevCursorPos_, streamIndex_, macroTargetPos_, comment_, lastComment_ };
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SetCursorState(const CursorState& state)
+{
+	cursorPos_ = state.cursorPos;
+	prevCursorPos_ = state.prevCursorPos;
+	streamIndex_ = state.streamIndex;
+	macroTargetPos_ = state.macroTargetPos;
+	comment_ = state.comment;
+	lastComment_ = state.lastComment;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::SkipLiteral(size_t pos) const
+{
+	const char quote = input_[pos];
+
+	// Raw strings may contain anything including new lines
+	if (quote == '"')
+	{
+		const size_t end = SkipRawLiteral(pos);
+		if (end != std::string_view::npos)
+			return end;
+	}
+
+	// A quote between two digits is a digit separator
+	if (quote == '\'' && pos > 0 && pos + 1 < inputLength_ &&
+		std::isxdigit(std::char_traits<char>::to_int_type(input_[pos - 1])) &&
+		std::isxdigit(std::char_traits<char>::to_int_type(input_[pos + 1])))
+		return pos + 1;
+
+	// Literals do not span multiple lines, stop at the end of the line if the closing quote is missing
+	for (++pos; pos < inputLength_;)
+	{
+		pos += ScanUntilAny(input_ + pos, inputLength_ - pos, quote, '\\', '\n', quote);
+		if (pos >= inputLength_ || input_[pos] == '\n')
+			return pos;
+		if (input_[pos] == quote)
+			return pos + 1;
+		pos += 2;
+	}
+
+	return inputLength_;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::SkipRawLiteral(size_t pos) const
+{
+	if (pos == 0 || input_[pos - 1] != 'R')
+		return std::string_view::npos;
+
+	// The R is either the whole prefix or follows one of the encoding prefixes u8, u, U and L
+	size_t prefix = pos - 1;
+	if (prefix >= 2 && input_[prefix - 2] == 'u' && input_[prefix - 1] == '8')
+		prefix -= 2;
+	else if (prefix >= 1 && (input_[prefix - 1] == 'u' || input_[prefix - 1] == 'U' || input_[prefix - 1] == 'L'))
+		prefix -= 1;
+
+	if (prefix > 0 && ScanIdentifier(input_ + prefix - 1, 1) != 0)
+		return std::string_view::npos;
+
+	// The delimiter is at most 16 characters long and ends with '('
+	const std::string_view input(input_, inputLength_);
+	const size_t open = input.find('(', pos + 1);
+	if (open == std::string_view::npos || open - pos - 1 > 16)
+		return std::string_view::npos;
+
+	const std::string_view delimiter = input.substr(pos + 1, open - pos - 1);
+	if (delimiter.find_first_of(" \\)\t\v\f\r\n") != std::string_view::npos)
+		return std::string_view::npos;
+
+	// Search for )delimiter"
+	for (size_t end = input.find(')', open + 1); end != std::string_view::npos; end = input.find(')', end + 1))
+	{
+		if (input.compare(end + 1, delimiter.length(), delimiter) == 0 &&
+			end + 1 + delimiter.length() < inputLength_ && input_[end + 1 + delimiter.length()] == '"')
+			return end + 2 + delimiter.length();
+	}
+
+	return inputLength_;
+}
+
+//--------------------------------------------------------------------------------------------------
+size_t Tokenizer::SkipComment(size_t pos) const
+{
+	const char next = pos + 1 < inputLength_ ? input_[pos + 1] : '\0';
+	if (next == '/')
+		return index_.NextNewLine(pos);
+
+	if (next == '*')
+	{
+		size_t end = std::string_view(input_, inputLength_).find("*/", pos + 2);
+		return end == std::string_view::npos ? inputLength_ : end + 2;
+	}
+
+	return pos + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
 bool Tokenizer::AddMacro(const std::string_view& macro)
 {
-	return m_macros.emplace(macro).second;
+	// Cached identifiers might be the new macro
+	InvalidateTokenCache();
+	return m_macros.Add(macro);
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::SetMacroTable(const MacroTable* macros)
+{
+	InvalidateTokenCache();
+	m_sharedMacros = macros;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::IsMacro(const std::string_view& identifier) const
+{
+	const bool hasSharedMacros = m_sharedMacros != nullptr && !m_sharedMacros->Empty();
+	if (!hasSharedMacros && m_macros.Empty())
+		return false;
+
+	// Hash once for both tables
+	const uint64_t hash = MacroTable::Hash(identifier);
+	return (hasSharedMacros && m_sharedMacros->Contains(identifier, hash)) || m_macros.Contains(identifier, hash);
 }
 
 bool Tokenizer::ParseMacro(Token& token)
@@ -272,7 +994,167 @@ bool Tokenizer::ParseMacro(Token& token)
 }
 
 //--------------------------------------------------------------------------------------------------
-bool Tokenizer::GetToken(Token &token, bool angleBracketsForStrings, bool seperateBraces)
+template<LexMode mode>
+bool Tokenizer::GetToken(Token &token)
+{
+	// Pre-lexed tokens are read from the stream, unless they have to be lexed differently
+	if (stream_ != nullptr)
+	{
+		const std::size_t index = FindStreamToken<mode>();
+		if (index != std::string_view::npos)
+			return ReadStreamToken(token, index);
+
+		const std::size_t startPos = cursorPos_;
+		if (!LexToken<mode>(token))
+			return false;
+
+		++tokensLexed_;
+		CountLexed(startPos);
+		return true;
+	}
+
+	const unsigned flags = unsigned(mode) | (m_macrosEnabled ? 4 : 0);
+
+	// Replay the token if it was lexed from this position before
+	for (auto& entry : tokenCache_)
+	{
+		if (entry.startPos != cursorPos_ || entry.flags != flags)
+			continue;
+
+		if (comment_.length != 0)
+			lastComment_ = comment_;
+		comment_ = entry.comment;
+
+		token = entry.token;
+		cursorPos_ = entry.cursorPos;
+		prevCursorPos_ = entry.prevCursorPos;
+
+		++tokenCacheHits_;
+		return true;
+	}
+
+	const std::size_t startPos = cursorPos_;
+	const std::size_t macrosParsed = macrosParsed_;
+	if (!LexToken<mode>(token))
+		return false;
+
+	++tokensLexed_;
+	CountLexed(startPos);
+
+	// Macros change the comment state more than once, don't cache them
+	if (macrosParsed_ == macrosParsed)
+	{
+		auto& entry = tokenCache_[tokenCacheNext_];
+		tokenCacheNext_ = (tokenCacheNext_ + 1) % kTokenCacheSize;
+
+		entry.startPos = startPos;
+		entry.flags = flags;
+		entry.token = token;
+		entry.cursorPos = cursorPos_;
+		entry.prevCursorPos = prevCursorPos_;
+		entry.comment = comment_;
+	}
+
+	return true;
+}
+
+template bool Tokenizer::GetToken<LexMode::kDefault>(Token& token);
+template bool Tokenizer::GetToken<LexMode::kAngleBracketStrings>(Token& token);
+template bool Tokenizer::GetToken<LexMode::kSeparateBraces>(Token& token);
+
+//--------------------------------------------------------------------------------------------------
+template<LexMode mode>
+size_t Tokenizer::FindStreamToken()
+{
+	const TokenStream& stream = *stream_;
+
+	// Reading on from the last token is the common case, anything else was a jump of the cursor
+	size_t index = streamIndex_;
+	if ((index < stream.Size() && stream.GetOffset(index) < cursorPos_) ||
+		(index > 0 && stream.GetOffset(index - 1) >= cursorPos_))
+		index = stream.LowerBound(cursorPos_);
+
+	// Leave the end of the input and the comments behind the last token to the lexer
+	if (index == stream.Size())
+		return std::string_view::npos;
+
+	// The cursor was moved into the middle of a token
+	if (index > 0 && stream.GetEnd(index - 1) > cursorPos_)
+		return std::string_view::npos;
+
+	// The cursor was moved into the middle of the comments in front of the token
+	const uint32_t comment = stream.GetComment(index);
+	if (comment != 0 && cursorPos_ > stream.GetCommentStart(comment) && cursorPos_ < stream.GetOffset(index))
+		return std::string_view::npos;
+
+	// The stream was lexed without angle bracket strings and with '>>' as a single symbol
+	const char* str = input_ + stream.GetOffset(index);
+	if (mode == LexMode::kAngleBracketStrings && str[0] == '<')
+		return std::string_view::npos;
+	if (mode == LexMode::kSeparateBraces && stream.GetLength(index) > 1 && str[0] == '>' && str[1] == '>')
+		return std::string_view::npos;
+
+	return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::ReadStreamToken(Token& token, size_t index)
+{
+	const TokenStream& stream = *stream_;
+	const size_t offset = stream.GetOffset(index);
+	const size_t end = stream.GetEnd(index);
+
+	// Replay the comment block in front of the token like GetLeadingChar would have read it from the cursor
+	if (comment_.length != 0)
+		lastComment_ = comment_;
+
+	const uint32_t comment = stream.GetComment(index);
+	if (comment != 0 && cursorPos_ <= stream.GetCommentStart(comment))
+	{
+		comment_.offset = stream.GetCommentStart(comment);
+		comment_.length = stream.GetCommentLength(comment);
+		comment_.endPos = stream.GetCommentEnd(comment);
+	}
+	else
+	{
+		comment_.offset = cursorPos_;
+		comment_.length = 0;
+		comment_.endPos = cursorPos_;
+	}
+
+	token.tokenType = stream.GetType(index);
+	token.keyword = stream.GetKeyword(index);
+	token.constType = stream.GetConstType(index);
+	token.unterminated = stream.IsUnterminated(index);
+	token.startPos = uint32_t(offset);
+	token.length = uint32_t(end - offset);
+
+	streamIndex_ = index + 1;
+	SetCursor(end);
+
+	// The stream only knows the type of numbers once they are decoded
+	ConstValue value;
+	if (token.tokenType == TokenType::kConst && token.constType != ConstType::kString && token.constType != ConstType::kBoolean)
+	{
+		token.constType = DecodeNumber(GetText(token), value) ? value.constType : ConstType::kUnknown;
+	}
+	else if (token.tokenType == TokenType::kIdentifier && m_macrosEnabled && IsMacro(GetText(token)))
+	{
+		token.tokenType = TokenType::kMacro;
+		if (!ParseMacro(token)) {
+			return Error("Invalid syntax");
+		}
+
+		GetToken(token);
+		macroTargetPos_ = token.startPos;
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+template<LexMode mode>
+bool Tokenizer::LexToken(Token &token)
 {
 	// Get the next character
 	char c = GetLeadingChar();
@@ -287,15 +1169,17 @@ bool Tokenizer::GetToken(Token &token, bool angleBracketsForStrings, bool sepera
 	}
 
 	// Record the start of the token position
-	token.startPos = prevCursorPos_;
-	token.startLine = prevCursorLine_;
-	token.token = std::string_view();
 	token.tokenType = TokenType::kNone;
+	token.keyword = Keyword::kNone;
+	token.unterminated = false;
+	token.startPos = uint32_t(prevCursorPos_);
+	token.length = 0;
 
 	// Alphanumeric token
 	if(std::isalpha(intc) || c == '_')
 	{
 		// Read the rest of the alphanumeric characters
+		cursorPos_ += ScanIdentifier(input_ + cursorPos_, inputLength_ - cursorPos_);
 		do
 		{
 			c = GetChar();
@@ -305,31 +1189,28 @@ bool Tokenizer::GetToken(Token &token, bool angleBracketsForStrings, bool sepera
 		// Put back the last read character since it's not part of the identifier
 		UngetChar();
 		
-		token.token = std::string_view(input_ + token.startPos, cursorPos_ - token.startPos);
+		token.length = uint32_t(cursorPos_ - token.startPos);
+		const std::string_view text(input_ + token.startPos, token.length);
 
 		// Set the type of the token
 		token.tokenType = TokenType::kIdentifier;
+		token.keyword = LookupKeyword(text);
 
-		if(token.token == "true")
+		if(token.keyword == Keyword::kTrue || token.keyword == Keyword::kFalse)
 		{
 			token.tokenType = TokenType::kConst;
 			token.constType = ConstType::kBoolean;
-			token.boolConst = true;
 		}
-		else if(token.token == "false")
-		{
-			token.tokenType = TokenType::kConst;
-			token.constType = ConstType::kBoolean;
-			token.boolConst = false;
-		}
-		else if (m_macrosEnabled && m_macros.find(std::string(token.token)) != m_macros.cend())
+		else if (m_macrosEnabled && IsMacro(text))
 		{
 			token.tokenType = TokenType::kMacro;
+			++macrosParsed_;
 			if (!ParseMacro(token)) {
 				return Error("Invalid syntax");
 			}
 
 			GetToken(token);
+			macroTargetPos_ = token.startPos;
 		}
 
 		return true;
@@ -337,82 +1218,57 @@ bool Tokenizer::GetToken(Token &token, bool angleBracketsForStrings, bool sepera
 	// Constant
 	else if(std::isdigit(intc) || ((c == '-' || c == '+') && std::isdigit(intp)))
 	{
-		bool isFloat = false;
-		bool isHex = false;
-		bool isNegated = c == '-';
-		const char* start = input_ + cursorPos_;
-		size_t size = 0;
-		do
+		// Read a preprocessing number: digits, letters, periods, digit separators and signs of exponents
+		const size_t digitsPos = std::isdigit(intc) ? token.startPos : cursorPos_;
+		const bool isHex = digitsPos + 1 < inputLength_ && input_[digitsPos] == '0' && (input_[digitsPos + 1] == 'x' || input_[digitsPos + 1] == 'X');
+		for (;;)
 		{
-			if(c == '.')
-				isFloat = true;
-
-			if(c == 'x' || c == 'X')
-				isHex = true;
+			// Skip the run of digits and letters that follows
+			if (!is_eof())
+				cursorPos_ += ScanIdentifier(input_ + cursorPos_, inputLength_ - cursorPos_);
 
+			const char last = input_[cursorPos_ - 1];
 			c = GetChar();
 			intc = std::char_traits<char>::to_int_type(c);
+			if (c == '.' || (c == '\'' && std::isalnum(std::char_traits<char>::to_int_type(peek()))))
+				continue;
+			if ((c == '+' || c == '-') && (isHex ? (last == 'p' || last == 'P') : (last == 'e' || last == 'E')))
+				continue;
+			if (!std::isalnum(intc) && c != '_')
+				break;
+		}
 
-			++size;
-
-		} while(std::isdigit(intc) ||
-				(!isFloat && c == '.') ||
-				(!isHex && (c == 'X' || c == 'x')) ||
-				(isHex && std::isxdigit(intc)));
-
-		if(!isFloat || (c != 'f' && c != 'F'))
-			UngetChar();
+		UngetChar();
 
-		token.token = std::string_view(input_ + token.startPos, cursorPos_ - token.startPos);
+		token.length = uint32_t(cursorPos_ - token.startPos);
 		token.tokenType = TokenType::kConst;
-		if(!isFloat)
-		{
-			try
-			{
-				if(isNegated)
-				{
-					token.int32Const = std::stoi(std::string(token.token), 0, 0);
-					token.constType = ConstType::kInt32;
-				}
-				else
-				{
-					token.uint32Const = std::stoul(std::string(token.token), 0, 0);
-					token.constType = ConstType::kUInt32;
-				}
-			}
-			catch(std::out_of_range)
-			{
-				if(isNegated)
-				{
-					token.int64Const = std::stoll(std::string(token.token), 0, 0);
-					token.constType = ConstType::kInt64;
-				}
-				else
-				{
-					token.uint64Const = std::stoull(std::string(token.token), 0, 0);
-					token.constType = ConstType::kUInt64;
-				}
-			}
-		}
-		else
+
+		// The token stream decodes the number when the token is read, until then any number type will do
+		if (pretokenizing_)
 		{
-			token.realConst = std::stod(std::string(token.token));
-			token.constType = ConstType::kReal;
+			token.constType = ConstType::kUInt32;
+			return true;
 		}
 
+		// Only the type is kept, GetConstValue decodes the value again when it is needed.
+		// A number that cannot be decoded is still a constant, only its value is unknown.
+		ConstValue value;
+		token.constType = DecodeNumber(std::string_view(input_ + token.startPos, token.length), value) ? value.constType : ConstType::kUnknown;
+
 		return true;
 	}
-	else if (c == '"' || (angleBracketsForStrings && c == '<'))
+	else if (c == '"' || (mode == LexMode::kAngleBracketStrings && c == '<'))
 	{
 		const char closingElement = c == '"' ? '"' : '>';
 
+		// GetChar moves the cursor past the end of the input when it returns the end of file
 		c = GetChar();
-		while (c != closingElement && std::char_traits<char>::not_eof(std::char_traits<char>::to_int_type(c)))
+		while (c != closingElement && cursorPos_ <= inputLength_)
 		{
 			if(c == '\\')
 			{
 				c = GetChar();
-				if(!std::char_traits<char>::not_eof(std::char_traits<char>::to_int_type(c)))
+				if(cursorPos_ > inputLength_)
 					break;
 				else if(c == 'n')
 					c = '\n';
@@ -427,57 +1283,41 @@ bool Tokenizer::GetToken(Token &token, bool angleBracketsForStrings, bool sepera
 			c = GetChar();
 		}
 
+		// Strings without closing element end at the end of the input
 		if (c != closingElement)
+		{
 			UngetChar();
+			token.unterminated = true;
+		}
 
-		token.token = std::string_view(input_ + token.startPos + 1, cursorPos_ - token.startPos - 2);
+		token.length = uint32_t(cursorPos_ - token.startPos);
 		token.tokenType = TokenType::kConst;
 		token.constType = ConstType::kString;
-		token.stringConst = std::string(token.token);
 
 		return true;
 	}
 	// Symbol
 	else
 	{
-		// Push back the symbol
-		#define PAIR(cc,dd) (c==cc&&d==dd) /* Comparison macro for two characters */
+		// Symbols of more than one character are found with a single table probe
 		const char d = GetChar();
-		if(PAIR('<', '<') ||
-			 PAIR('-', '>') ||
-			 (!seperateBraces && PAIR('>', '>')) ||
-			 PAIR('!', '=') ||
-			 PAIR('<', '=') ||
-			 PAIR('>', '=') ||
-			 PAIR('+', '+') ||
-			 PAIR('-', '-') ||
-			 PAIR('+', '=') ||
-			 PAIR('-', '=') ||
-			 PAIR('*', '=') ||
-			 PAIR('/', '=') ||
-			 PAIR('^', '=') ||
-			 PAIR('|', '=') ||
-			 PAIR('&', '=') ||
-			 PAIR('~', '=') ||
-			 PAIR('%', '=') ||
-			 PAIR('&', '&') ||
-			 PAIR('|', '|') ||
-			 PAIR('=', '=') ||
-			 PAIR(':', ':') ||
-			 PAIR('.', '.')
-			)
-		#undef PAIR
+		const bool isSplit = mode == LexMode::kSeparateBraces && c == '>' && d == '>';
+		if (kOperators.Contains(c, d) && !isSplit)
 		{
-			const char e = GetChar();
-			if (e != '.') {
-				UngetChar();
+			// Only .. continues to ...
+			if (c == '.')
+			{
+				const char e = GetChar();
+				if (e != '.') {
+					UngetChar();
+				}
 			}
 		}
 		else
 			UngetChar();
 
 		token.tokenType = TokenType::kSymbol;
-		token.token = std::string_view(input_ + token.startPos, cursorPos_ - token.startPos);
+		token.length = uint32_t(cursorPos_ - token.startPos);
 
 		return true;
 	}
@@ -491,6 +1331,50 @@ bool Tokenizer::is_eof() const
 	return cursorPos_ >= inputLength_;
 }
 
+//--------------------------------------------------------------------------------------------------
+bool Tokenizer::GetConstValue(const Token& token, ConstValue& value) const
+{
+	if (token.tokenType != TokenType::kConst)
+		return false;
+
+	switch (token.constType)
+	{
+	case ConstType::kString:
+	case ConstType::kUnknown:
+		return false;
+	case ConstType::kBoolean:
+		value.constType = ConstType::kBoolean;
+		value.boolConst = token.keyword == Keyword::kTrue;
+		return true;
+	default:
+		return DecodeNumber(GetText(token), value);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void Tokenizer::GetString(const Token& token, std::string& buffer) const
+{
+	const std::string_view text = GetText(token);
+	buffer.clear();
+	buffer.reserve(text.length());
+
+	for (size_t i = 0; i < text.length(); ++i)
+	{
+		char c = text[i];
+		if (c == '\\' && i + 1 < text.length())
+		{
+			c = text[++i];
+			if(c == 'n')
+				c = '\n';
+			else if(c == 't')
+				c = '\t';
+			else if(c == 'r')
+				c = '\r';
+		}
+		buffer += c;
+	}
+}
+
 //--------------------------------------------------------------------------------------------------
 bool Tokenizer::GetConst(Token &token)
 {
@@ -520,8 +1404,14 @@ bool Tokenizer::GetIdentifier(Token &token)
 //--------------------------------------------------------------------------------------------------
 void Tokenizer::UngetToken(const Token &token)
 {
-	cursorLine_ = token.startLine;
 	cursorPos_ = token.startPos;
+
+	// Going back in the token stream only moves the index back
+	if (stream_ != nullptr)
+	{
+		while (streamIndex_ > 0 && stream_->GetOffset(streamIndex_ - 1) >= token.startPos)
+			--streamIndex_;
+	}
 }
 
 std::string_view Tokenizer::GetError()
@@ -535,7 +1425,7 @@ bool Tokenizer::MatchIdentifier(const std::string_view &identifier)
 	Token token;
 	if(GetToken(token))
 	{
-		if(token.tokenType == TokenType::kIdentifier && token.token == identifier)
+		if(token.tokenType == TokenType::kIdentifier && GetText(token) == identifier)
 			return true;
 
 		UngetToken(token);
@@ -545,12 +1435,28 @@ bool Tokenizer::MatchIdentifier(const std::string_view &identifier)
 }
 
 //--------------------------------------------------------------------------------------------------
+bool Tokenizer::MatchKeyword(Keyword keyword)
+{
+	Token token;
+	if(GetToken(token))
+	{
+		if(token.tokenType == TokenType::kIdentifier && token.keyword == keyword)
+			return true;
+
+		UngetToken(token);
+	}
+
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+template<LexMode mode>
 bool Tokenizer::MatchSymbol(const std::string_view& symbol)
 {
 	Token token;
-	if(GetToken(token, false, symbol.length() == 1 && symbol[0] == '>'))
+	if(GetToken<mode>(token))
 	{
-		if(token.tokenType == TokenType::kSymbol && token.token == symbol)
+		if(token.tokenType == TokenType::kSymbol && GetText(token) == symbol)
 			return true;
 
 		UngetToken(token);
@@ -568,13 +1474,19 @@ bool Tokenizer::RequireIdentifier(const std::string_view& identifier)
 }
 
 //--------------------------------------------------------------------------------------------------
+template<LexMode mode>
 bool Tokenizer::RequireSymbol(const std::string_view& symbol)
 {
-	if (!MatchSymbol(symbol))
+	if (!MatchSymbol<mode>(symbol))
 		return Error("Expected '%.*s'", symbol.length(), symbol.data());
 	return true;
 }
 
+template bool Tokenizer::MatchSymbol<LexMode::kDefault>(const std::string_view& symbol);
+template bool Tokenizer::MatchSymbol<LexMode::kSeparateBraces>(const std::string_view& symbol);
+template bool Tokenizer::RequireSymbol<LexMode::kDefault>(const std::string_view& symbol);
+template bool Tokenizer::RequireSymbol<LexMode::kSeparateBraces>(const std::string_view& symbol);
+
 void Tokenizer::SetMacroParsing(bool enabled)
 {
 	m_macrosEnabled = enabled;
@@ -588,7 +1500,7 @@ bool Tokenizer::Error(const char* fmt, ...)
 	std::ostringstream str;
 	va_start(args, fmt);
 	vsnprintf(buffer, 512, fmt, args);
-	str << "ParserError: " << (int)cursorLine_ << ":0: " << buffer;
+	str << "ParserError: " << GetLine(cursorPos_) << ":" << GetColumn(cursorPos_) << ": " << buffer;
 	error_ = str.str();
 	hasError_ = true;
 	va_end(args);
@@ -3,9 +3,25 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
-#include <unordered_set>
 
-struct Token;
+#include "macro_table.h"
+#include "structural_index.h"
+#include "token.h"
+
+class TokenStream;
+
+/// Selects how GetToken lexes the characters that can be read in more than one way
+enum class LexMode : uint8_t
+{
+	/// '>>' is a single symbol
+	kDefault,
+
+	/// '<' starts a string that ends with '>', as in the path of an #include
+	kAngleBracketStrings,
+
+	/// '>>' is read as two symbols, so nested template argument lists can be closed one at a time
+	kSeparateBraces
+};
 
 class Tokenizer
 {
@@ -20,12 +36,31 @@ public:
 	/// Reset the parser with the given input text
 	void Reset(const char* input, size_t size);
 
-	/// Parses a token from the stream
-	bool GetToken(Token& token, bool angleBracketsForStrings = false, bool seperateBraces = false);
+	/// Makes Reset lex the whole input into the given stream up front, after which tokens are read from the stream.
+	/// The stream must outlive the tokenizer, pass nullptr to lex tokens as they are requested.
+	void SetTokenStream(TokenStream* stream);
+
+	/// Parses a token from the stream, the lexing mode is chosen at compile time
+	template<LexMode mode = LexMode::kDefault>
+	bool GetToken(Token& token);
 
 	/// Parses an constant from the stream
 	bool GetConst(Token& token);
 
+	/// Returns the text of the token, strings without their quotes
+	std::string_view GetText(const Token& token) const
+	{
+		if (token.tokenType == TokenType::kConst && token.constType == ConstType::kString)
+			return std::string_view(input_ + token.startPos + 1, token.length - (token.unterminated ? 1 : 2));
+		return std::string_view(input_ + token.startPos, token.length);
+	}
+
+	/// Decodes the value of a boolean or number constant, returns false for any other token and for numbers of unknown value
+	bool GetConstValue(const Token& token, ConstValue& value) const;
+
+	/// Writes the contents of a string constant with its escape sequences resolved to buffer
+	void GetString(const Token& token, std::string& buffer) const;
+
 	/// Parses an identifier from the stream
 	bool GetIdentifier(Token& token);
 
@@ -34,8 +69,24 @@ public:
 
 	std::string_view GetError();
 
+	/// Adds a macro for this tokenizer only, the name is copied
 	bool AddMacro(const std::string_view& macro);
 
+	/// Sets macros shared with other tokenizers. The table must not change and must outlive the tokenizer.
+	void SetMacroTable(const MacroTable* macros);
+
+	/// Returns the number of tokens lexed since the last reset
+	std::size_t GetTokensLexed() const { return tokensLexed_; }
+
+	/// Returns the number of times a token was taken from the token cache instead of being lexed again
+	std::size_t GetTokenCacheHits() const { return tokenCacheHits_; }
+
+	/// Returns the number of bytes the lexer went over since the last reset
+	std::size_t GetBytesLexed() const { return bytesLexed_; }
+
+	/// Returns the number of bytes that were lexed more than once, the token cache and stream keep this low
+	std::size_t GetBytesRelexed() const { return bytesRelexed_; }
+
 	bool ParseMacro(Token& token);
 
 protected:
@@ -51,27 +102,111 @@ protected:
 	/// Returns the next character from the stream but skips comments and white spaces.
 	char GetLeadingChar();
 
+	/// Returns true if the line of a line comment has no text once the slashes and indentation are removed
+	static bool IsEmptyCommentLine(const char* str, std::size_t length);
+
+	/// Advances the cursor past a run of white spaces and control characters.
+	void SkipWhitespace();
+
+	/// Advances the cursor past the next ';' outside of braces or past the '}' that closes the first opened brace.
+	/// String and character literals and comments are skipped over. Returns false if the end of the stream was reached.
+	bool SkipStatement();
+
+	/// Returns the position SkipStatement would advance the cursor to, or npos if the statement does not end
+	std::size_t FindStatementEnd() const;
+
+	/// Returns the position of the first use of a known macro between begin and end, or npos if there is none.
+	/// Macros inside braces are only found if nested is set, comments, literals and directives are skipped.
+	std::size_t FindMacroUse(std::size_t begin, std::size_t end, bool nested) const;
+
+	/// Returns true if the token was read right after a macro, that is if the macro annotates it
+	bool FollowsMacro(const Token& token) const { return token.startPos == macroTargetPos_; }
+
+	/// Returns the position of the next ',' or ')' outside of parentheses and braces, the cursor is left untouched.
+	/// This is where an expression like a default argument ends, lambda bodies and initializer lists are skipped over.
+	std::size_t FindExpressionEnd() const;
+
+	/// Advances the cursor to the #elif, #else or #endif that ends the current branch of a conditional, skipping over
+	/// nested conditionals, comments and literals. Returns false if the end of the stream was reached.
+	bool SkipConditionalBranch();
+
+	/// Advances the cursor past the end of the current line, following line continuations if requested.
+	void SkipLine(bool continuation);
+
+	/// Returns the position after the end of the line pos is on, following line continuations if requested
+	std::size_t FindLineEnd(std::size_t pos, bool continuation) const;
+
+	/// Returns true if only white space precedes pos on its line
+	bool IsLineStart(std::size_t pos) const;
+
+	/// Moves the cursor forward to the given position, the tokens in between are never read
+	void SkipTo(std::size_t pos);
+
+	/// Moves the cursor to the given position
+	void SetCursor(std::size_t pos);
+
+	/// Returns the line (starting at 1) of the given position, computed from the line index
+	std::size_t GetLine(std::size_t pos) const { return index_.LineAt(pos); }
+
+	/// Returns the column (starting at 1) of the given position
+	std::size_t GetColumn(std::size_t pos) const;
+
+	/// Forgets all cached tokens
+	void InvalidateTokenCache();
+
 	/// Returns the next character from the stream without modifying the cursor position.
 	char peek() const;
 
 	/// Returns true if the stream is at the end
 	bool is_eof() const;
 
+private:
+	/// Lexes a token from the stream, bypassing the token cache
+	template<LexMode mode>
+	bool LexToken(Token& token);
+
+	/// Lexes the whole input into the token stream
+	void Pretokenize();
+
+	/// Returns the index of the stream token at the cursor, or npos if the token has to be lexed instead
+	template<LexMode mode>
+	std::size_t FindStreamToken();
+
+	/// Reads a token from the token stream and moves the cursor past it
+	bool ReadStreamToken(Token& token, std::size_t index);
+
+	/// Returns the position after the string or character literal that starts at pos
+	std::size_t SkipLiteral(std::size_t pos) const;
+
+	/// Returns the position after the raw string literal whose opening quote is at pos, or npos if it is no raw string
+	std::size_t SkipRawLiteral(std::size_t pos) const;
+
+	/// Returns the position after the comment that starts at pos, or the next position if there is no comment
+	std::size_t SkipComment(std::size_t pos) const;
+
 protected:
 	/// Returns true if the current token is an identifier with the given text
 	bool MatchIdentifier(const std::string_view &identifier);
 
+	/// Returns true if the current token is an identifier spelling the given keyword
+	bool MatchKeyword(Keyword keyword);
+
 	/// Returns true if the current token is a symbol with the given text
+	template<LexMode mode = LexMode::kDefault>
 	bool MatchSymbol(const std::string_view &symbol);
 
 	/// Advances the tokenizer past the expected identifier or errors if the symbol is not encountered.
 	bool RequireIdentifier(const std::string_view& identifier);
 
 	/// Advances the tokenizer past the expected symbol or errors if the symbol is not encountered.
+	template<LexMode mode = LexMode::kDefault>
 	bool RequireSymbol(const std::string_view& symbol);
 
 	void SetMacroParsing(bool enabled);
 
+	/// Returns true if the identifier is a shared macro or a macro added to this tokenizer
+	bool IsMacro(const std::string_view& identifier) const;
+
 protected:
 	bool Error(const char* fmt, ...);
 	bool HasError() const { return hasError_; }
@@ -86,28 +221,85 @@ protected:
 	/// Current position in the input
 	std::size_t cursorPos_;
 
-	/// Current line of the cursor
-	std::size_t cursorLine_;
-
 	/// The cursor position of the last read character
 	std::size_t prevCursorPos_;
 
-	/// The cursor line of the the last read character
-	std::size_t prevCursorLine_;
+	/// Index of the structural characters and lines of the input
+	StructuralIndex index_;
 
-	/// Stores the last comment block
+	/// Stores the span of the last comment block, the length is 0 if there is no comment or it has no text.
+	/// endPos is the position of the token that follows the comment.
 	struct Comment {
-		std::string text;
-		std::size_t startLine;
-		std::size_t endLine;
+		std::size_t offset;
+		std::size_t length;
+		std::size_t endPos;
 	};
 
+	/// Writes the text of the comment to buffer, with comment markers, indentation and empty lines at the end removed
+	void GetCommentText(const Comment& comment, std::string& buffer) const;
+
 	Comment comment_;
 	Comment lastComment_;
 
+	/// Everything that decides which token is read next and which comment belongs to it
+	struct CursorState {
+		std::size_t cursorPos;
+		std::size_t prevCursorPos;
+		std::size_t streamIndex;
+		std::size_t macroTargetPos;
+		Comment comment;
+		Comment lastComment;
+	};
+
+	/// Returns the reading position, SetCursorState continues reading from there as if the tokens in between were read again
+	CursorState GetCursorState() const;
+	void SetCursorState(const CursorState& state);
+
 	bool hasError_ = false;
 	std::string error_;
 
 	bool m_macrosEnabled;
-	std::unordered_set<std::string_view> m_macros;
+	const MacroTable* m_sharedMacros;
+	MacroTable m_macros;
+
+private:
+	/// A token lexed from startPos together with the tokenizer state after lexing it
+	struct CachedToken {
+		std::size_t startPos;
+		unsigned flags;
+		Token token;
+		std::size_t cursorPos;
+		std::size_t prevCursorPos;
+		Comment comment;
+	};
+
+	/// The most recently lexed tokens, so reading a token again after UngetToken does not lex it again
+	static const std::size_t kTokenCacheSize = 16;
+	CachedToken tokenCache_[kTokenCacheSize];
+	std::size_t tokenCacheNext_;
+
+	/// The pre-lexed tokens of the input, if any
+	TokenStream* stream_;
+
+	/// Index of the stream token that is expected to be read next
+	std::size_t streamIndex_;
+
+	/// Set while the input is being lexed into the token stream
+	bool pretokenizing_;
+
+	std::size_t macrosParsed_;
+
+	/// Position of the token that follows the last macro that was read
+	std::size_t macroTargetPos_;
+	std::size_t tokensLexed_;
+	std::size_t tokenCacheHits_;
+
+	std::size_t bytesLexed_;
+	std::size_t bytesRelexed_;
+
+	/// The end of the furthest token lexed so far, bytes in front of it are lexed again
+	std::size_t lexedEnd_;
+
+	/// Adds the bytes from startPos to the cursor to the lexing statistics
+	void CountLexed(std::size_t startPos);
 };
\ No newline at end of file
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <vector>
-#include <memory>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 enum class SignednessSpecifier
 {
@@ -74,9 +74,14 @@ struct Specifiers
 	}
 };
 
+/// Identifies a distinct type structure, see TypeTable
+typedef uint64_t TypeId;
+
+/// Node of a parsed type. The nodes of a type are stored in one array and refer to each other by index,
+/// there are no per node allocations and no virtual functions. Names are views of the source or the parser's arena.
 struct TypeNode
 {
-	enum class Type
+	enum class Type : uint8_t
 	{
 		kNone,
 		kPointer,
@@ -91,122 +96,35 @@ struct TypeNode
 		kFunctionPointer,
 	};
 
+	/// The index that refers to no node
+	static const uint32_t kNoNode = UINT32_MAX;
+
 	TypeNode(Type t) :
 		type(t) {}
 
-	virtual ~TypeNode() = default;
+	/// Returns true for the literals, templates and functions, whose name is part of the type
+	bool HasName() const { return type != Type::kNone && type != Type::kPointer && type != Type::kReference && type != Type::kLReference; }
 
 	Specifiers specifiers{};
 	SignednessSpecifier signedness = SignednessSpecifier::kNone;
 	SizeSpecifier size = SizeSpecifier::kNone;
 
 	Type type;
-	std::unique_ptr<TypeNode> parent = nullptr;
-};
 
-struct PointerNode : public TypeNode
-{
-	PointerNode(std::unique_ptr<TypeNode> && b) :
-		TypeNode(TypeNode::Type::kPointer),
-		base(std::forward<std::unique_ptr<TypeNode>>(b)){}
+	/// The name of a literal, template or function
+	std::string_view name;
 
-	std::unique_ptr<TypeNode> base;
-};
+	/// The name of the function argument this node is the type of
+	std::string_view argumentName;
 
-struct ReferenceNode : public TypeNode
-{
-	ReferenceNode(std::unique_ptr<TypeNode> && b) :
-		TypeNode(TypeNode::Type::kReference),
-		base(std::forward<std::unique_ptr<TypeNode>>(b)){}
-
-	std::unique_ptr<TypeNode> base;
-};
+	/// The base of a pointer or reference, the first argument of a template or the return type of a function.
+	/// The arguments of templates and functions follow the first child through next.
+	uint32_t child = kNoNode;
+	uint32_t next = kNoNode;
 
-struct LReferenceNode : public TypeNode
-{
-	LReferenceNode(std::unique_ptr<TypeNode> && b) :
-		TypeNode(TypeNode::Type::kLReference),
-		base(std::forward<std::unique_ptr<TypeNode>>(b)){}
-
-	std::unique_ptr<TypeNode> base;
-};
-
-struct TemplateNode : public TypeNode
-{
-	TemplateNode(const std::string_view& n) :
-		TypeNode(TypeNode::Type::kTemplate),
-		name(n) {}
-
-	std::string name;
-	std::vector<std::unique_ptr<TypeNode>> arguments;
-};
-
-struct LiteralNode : public TypeNode
-{
-	LiteralNode(const std::string_view& ref) :
-		TypeNode(TypeNode::Type::kLiteral),
-		name(ref)
-		{}
+	/// The node this node is a child of
+	uint32_t owner = kNoNode;
 
-	std::string name;
-};
-
-struct FunctionNode : public TypeNode
-{
-	FunctionNode()
-		: TypeNode(TypeNode::Type::kFunction)
-	{}
-
-	struct Argument
-	{
-		std::string name;
-		std::unique_ptr<TypeNode> type;
-	};
-
-	std::string name;
-	std::unique_ptr<TypeNode> returns;
-	std::vector<std::unique_ptr<Argument>> arguments;
-};
-
-struct ITypeNodeVisitor
-{
-	virtual void VisitNode(TypeNode &node, const std::string_view& name = std::string_view()) = 0;
-	virtual void Visit(PointerNode& node) = 0;
-	virtual void Visit(ReferenceNode& node) = 0;
-	virtual void Visit(LReferenceNode& node) = 0;
-	virtual void Visit(LiteralNode& node) = 0;
-	virtual void Visit(TemplateNode& node) = 0;
-	virtual void Visit(FunctionNode& node) = 0;
-};
-
-struct TypeNodeVisitor : public ITypeNodeVisitor
-{
-	void VisitNode(TypeNode &node, const std::string_view& name = std::string_view()) override
-	{
-		switch (node.type)
-		{
-		case TypeNode::Type::kPointer:
-			Visit(reinterpret_cast<PointerNode&>(node));
-			break;
-		case TypeNode::Type::kReference:
-			Visit(reinterpret_cast<ReferenceNode&>(node));
-			break;
-		case TypeNode::Type::kLReference:
-			Visit(reinterpret_cast<LReferenceNode&>(node));
-			break;
-		case TypeNode::Type::kLiteral:
-		case TypeNode::Type::kConstructor:
-		case TypeNode::Type::kDestructor:
-		case TypeNode::Type::kVariadic:
-			Visit(reinterpret_cast<LiteralNode&>(node));
-			break;
-		case TypeNode::Type::kTemplate:
-			Visit(reinterpret_cast<TemplateNode&>(node));
-			break;
-		case TypeNode::Type::kFunction:
-		case TypeNode::Type::kFunctionPointer:
-			Visit(reinterpret_cast<FunctionNode&>(node));
-			break;
-		}
-	}
+	/// The template a nested name is selected from (the Outer<T> of Outer<T>::type)
+	uint32_t parent = kNoNode;
 };
@@ -0,0 +1,213 @@
+#include "type_table.h"
+
+#include <mutex>
+
+namespace
+{
+	const char kEndOfNode = char(0xFF);
+
+	unsigned PackSpecifiers(const Specifiers& specifiers)
+	{
+		return specifiers.isInline | specifiers.isVirtual << 1 | specifiers.isConstExpr << 2 | specifiers.isStatic << 3 |
+			specifiers.isDefault << 4 | specifiers.isConstThis << 5 | specifiers.isOverride << 6 | specifiers.isAbstract << 7 |
+			specifiers.isConst << 8 | specifiers.isVolatile << 9 | specifiers.isMutable << 10 | specifiers.isDeleted << 11;
+	}
+
+	void AppendName(const std::string_view& name, std::string& key)
+	{
+		const uint32_t length = uint32_t(name.length());
+		key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		key.append(name);
+	}
+
+	/// Appends the structure of the type starting at root. Every node is followed by its children and an end marker,
+	/// which is never the first byte of a node.
+	void AppendKey(const std::vector<TypeNode>& nodes, uint32_t root, std::string& key)
+	{
+		uint32_t index = root;
+		for (;;)
+		{
+			const TypeNode& node = nodes[index];
+			const unsigned specifiers = PackSpecifiers(node.specifiers);
+			key.push_back(char(node.type));
+			key.push_back(char(specifiers));
+			key.push_back(char(specifiers >> 8));
+			key.push_back(char(node.signedness));
+			key.push_back(char(node.size));
+			AppendName(node.name, key);
+			AppendName(node.argumentName, key);
+
+			if (node.child != TypeNode::kNoNode)
+			{
+				index = node.child;
+				continue;
+			}
+
+			for (;;)
+			{
+				key.push_back(kEndOfNode);
+				if (index == root)
+					return;
+
+				if (nodes[index].next != TypeNode::kNoNode)
+				{
+					index = nodes[index].next;
+					break;
+				}
+				index = nodes[index].owner;
+			}
+		}
+	}
+
+	/// FNV-1a with a final mix, so the top bits that select the shard depend on every byte
+	uint64_t Hash(const std::string& key)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (char c : key)
+		{
+			hash ^= uint8_t(c);
+			hash *= 0x100000001B3ull;
+		}
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	/// Matches StorageSpecifierString of TypeData.cpp
+	void AppendStorageSpecifiers(const Specifiers& specifiers, std::string& out)
+	{
+		if (!specifiers.isInline && !specifiers.isConst && specifiers.isMutable)
+		{
+			out.append("mutable ");
+			return;
+		}
+
+		if (specifiers.isStatic)
+			out.append("static ");
+		if (specifiers.isConstExpr)
+			out.append("constexpr ");
+		if (specifiers.isInline)
+			out.append("inline ");
+		else if (specifiers.isConst)
+			out.append("const ");
+		if (specifiers.isVolatile)
+			out.append("volatile ");
+	}
+
+	void AppendSpelling(const std::vector<TypeNode>& nodes, uint32_t index, std::string& out);
+
+	/// Appends the spellings of a child and the children following it, separated by commas
+	void AppendList(const std::vector<TypeNode>& nodes, uint32_t child, std::string& out)
+	{
+		for (bool first = true; child != TypeNode::kNoNode; child = nodes[child].next, first = false)
+		{
+			if (!first)
+				out.push_back(',');
+			AppendSpelling(nodes, child, out);
+		}
+	}
+
+	/// Builds the same spelling as TypeData::ToString does for the tree the node's type events create
+	void AppendSpelling(const std::vector<TypeNode>& nodes, uint32_t index, std::string& out)
+	{
+		const TypeNode& node = nodes[index];
+
+		// The name of the node replaces the name of the argument it is the type of
+		const std::string_view name = node.HasName() ? node.name : node.argumentName;
+		switch (node.type)
+		{
+		case TypeNode::Type::kPointer:
+		case TypeNode::Type::kReference:
+		case TypeNode::Type::kLReference:
+			AppendStorageSpecifiers(node.specifiers, out);
+			AppendSpelling(nodes, node.child, out);
+			out.append(node.type == TypeNode::Type::kPointer ? "*" : node.type == TypeNode::Type::kReference ? "&" : "&&");
+			out.append(name);
+			break;
+		case TypeNode::Type::kLiteral:
+		case TypeNode::Type::kVariadic:
+			AppendStorageSpecifiers(node.specifiers, out);
+			out.append(name);
+			break;
+		case TypeNode::Type::kTemplate:
+			out.append(name).push_back('<');
+			AppendList(nodes, node.child, out);
+			out.push_back('>');
+			break;
+		case TypeNode::Type::kFunction:
+		case TypeNode::Type::kFunctionPointer:
+			AppendSpelling(nodes, node.child, out);
+			out.append(node.type == TypeNode::Type::kFunctionPointer ? "(*)(" : "(");
+			AppendList(nodes, nodes[node.child].next, out);
+			out.push_back(')');
+			break;
+		case TypeNode::Type::kConstructor:
+			out.append(name);
+			break;
+		case TypeNode::Type::kDestructor:
+			out.append("void");
+			break;
+		case TypeNode::Type::kNone:
+			break;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+TypeTable::TypeTable()
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+const TypeTable::Entry& TypeTable::Intern(const std::vector<TypeNode>& nodes, uint32_t root, std::string& key)
+{
+	key.clear();
+	AppendKey(nodes, root, key);
+
+	// Different structures with the same hash take the following ids
+	const TypeId hash = Hash(key);
+	Shard& shard = shards_[hash >> 58];
+	{
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		for (TypeId id = hash;; ++id)
+		{
+			const auto it = shard.entries.find(id);
+			if (it == shard.entries.cend())
+				break;
+			if (it->second.first == key)
+				return it->second.second;
+		}
+	}
+
+	// Another thread may have added the type since the lookup
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	TypeId id = hash;
+	for (;; ++id)
+	{
+		const auto it = shard.entries.find(id);
+		if (it == shard.entries.cend())
+			break;
+		if (it->second.first == key)
+			return it->second.second;
+	}
+
+	auto& value = shard.entries[id];
+	value.first = key;
+	value.second.id = id;
+	AppendSpelling(nodes, root, value.second.spelling);
+	return value.second;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t TypeTable::Size() const
+{
+	std::size_t size = 0;
+	for (const auto& shard : shards_)
+	{
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		size += shard.entries.size();
+	}
+	return size;
+}
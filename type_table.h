@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "type_node.h"
+
+/// Interns the types parsed by all threads. Every distinct type structure is assigned a TypeId, which is derived
+/// from a hash of the structure and therefore the same in every run, and its spelling is built only once.
+/// Entries are never removed, so the spellings stay valid as long as the table exists.
+class TypeTable
+{
+public:
+	TypeTable();
+
+	// Do not allow copy
+	TypeTable(const TypeTable& other) = delete;
+
+	struct Entry
+	{
+		TypeId id;
+
+		/// The spelling of the type, like TypeData::ToString writes it
+		std::string spelling;
+	};
+
+	/// Returns the entry of the type starting at root, adding it if the table doesn't hold it yet.
+	/// key is scratch storage for the caller to reuse between calls.
+	const Entry& Intern(const std::vector<TypeNode>& nodes, uint32_t root, std::string& key);
+
+	/// Returns the number of distinct types
+	std::size_t Size() const;
+
+private:
+	static const std::size_t kShardCount = 64;
+
+	/// The entries of the ids whose top bits select the shard, each with its key
+	struct Shard
+	{
+		mutable std::shared_mutex mutex;
+		std::unordered_map<TypeId, std::pair<std::string, Entry>> entries;
+	};
+
+	Shard shards_[kShardCount];
+};
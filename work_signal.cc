@@ -0,0 +1,58 @@
+#include "work_signal.h"
+
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WORK_SIGNAL_X86 1
+#endif
+
+namespace
+{
+	const uint32_t kMinSpins = 16;
+	const uint32_t kMaxSpins = 4096;
+}
+
+//--------------------------------------------------------------------------------------------------
+WorkSignal::WorkSignal() :
+	epoch_(0),
+	waiters_(0),
+	spinLimit_(kMinSpins)
+{
+
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkSignal::Notify()
+{
+	epoch_.fetch_add(1);
+	if (waiters_.load() == 0)
+		return;
+
+	// Taking the lock orders the notification after a waiter that checked the epoch and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+	}
+	condition_.notify_all();
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkSignal::Pause()
+{
+#ifdef WORK_SIGNAL_X86
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkSignal::AdaptSpinning(bool succeeded)
+{
+	// Spin longer while spinning pays off, and back off quickly once waits end up blocking anyway
+	const uint32_t spinLimit = spinLimit_.load(std::memory_order_relaxed);
+	if (succeeded)
+		spinLimit_.store(spinLimit < kMaxSpins ? spinLimit * 2 : kMaxSpins, std::memory_order_relaxed);
+	else
+		spinLimit_.store(spinLimit > kMinSpins ? spinLimit / 2 : kMinSpins, std::memory_order_relaxed);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/// Lets threads sleep until another thread signals that the state they wait for may have changed, for example that
+/// a queue is no longer empty. A waiter spins for a short time first, which avoids the sleep while the other side is
+/// busy. The number of spins adapts to how often spinning was enough before.
+class WorkSignal
+{
+public:
+	WorkSignal();
+
+	// Do not allow copy
+	WorkSignal(const WorkSignal& other) = delete;
+
+	/// Returns once ready() returns true. ready() is called again after every notification.
+	template<typename Predicate>
+	void Wait(const Predicate& ready)
+	{
+		const uint32_t spinLimit = spinLimit_.load(std::memory_order_relaxed);
+		for (uint32_t spin = 0; spin < spinLimit; ++spin)
+		{
+			if (ready())
+			{
+				AdaptSpinning(true);
+				return;
+			}
+			Pause();
+		}
+		AdaptSpinning(false);
+
+		// Waiters are counted before the state is checked, a notification after the check finds the waiter
+		waiters_.fetch_add(1);
+		for (;;)
+		{
+			const uint32_t epoch = epoch_.load();
+			if (ready())
+				break;
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [&]() { return epoch_.load() != epoch; });
+		}
+		waiters_.fetch_sub(1);
+	}
+
+	/// Wakes all waiting threads, call it after the state has changed
+	void Notify();
+
+private:
+	/// Tells the processor that this is a spin loop
+	static void Pause();
+
+	void AdaptSpinning(bool succeeded);
+
+	std::mutex mutex_;
+	std::condition_variable condition_;
+
+	/// Incremented by every notification
+	std::atomic<uint32_t> epoch_;
+
+	/// The number of threads that are blocking or about to block
+	std::atomic<uint32_t> waiters_;
+
+	/// The number of times a waiter checks the state before it blocks
+	std::atomic<uint32_t> spinLimit_;
+};